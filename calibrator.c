@@ -34,15 +34,26 @@ OF SUCH DAMAGE.
  * \copyright Copyright 2013, all rights reserved.
  */
 #include "config.h"
+#include "plugin.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <alloca.h>
 #include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
 #include <libxml/parser.h>
 #include <glib.h>
+#include <gmodule.h>
 #ifdef HAVE_MPI
 	#include <mpi.h>
 #endif
@@ -61,7 +72,74 @@ enum CalibrateAlgorithm
 {
 	CALIBRATE_ALGORITHM_MONTE_CARLO = 0,
 	CALIBRATE_ALGORITHM_SWEEP = 1,
-	CALIBRATE_ALGORITHM_GENETIC = 2
+	CALIBRATE_ALGORITHM_GENETIC = 2,
+	CALIBRATE_ALGORITHM_MCMC = 3,
+	CALIBRATE_ALGORITHM_ABC_SMC = 4,
+	CALIBRATE_ALGORITHM_SOBOL = 5,
+	CALIBRATE_ALGORITHM_PORTFOLIO = 6,
+	CALIBRATE_ALGORITHM_BLOCK_COORDINATE = 7,
+	CALIBRATE_ALGORITHM_PLUGIN = 8
+};
+
+/**
+ * \enum MultiExperiment
+ * \brief Enum to define how to pass all the experiments to the simulator in a
+ *   single run.
+ */
+enum MultiExperiment
+{
+	MULTI_EXPERIMENT_NONE = 0,
+	MULTI_EXPERIMENT_MANIFEST = 1,
+	MULTI_EXPERIMENT_ARGUMENTS = 2
+};
+
+/**
+ * \enum SteadyAction
+ * \brief Enum to define the action to do when a simulation reaches the \
+ *   steady state.
+ */
+enum SteadyAction
+{
+	STEADY_ACTION_SIGNAL = 0,
+	STEADY_ACTION_EXTRAPOLATE = 1
+};
+
+/**
+ * \enum Failure
+ * \brief Enum to define the failure classes of an experiment evaluation.
+ */
+enum Failure
+{
+	FAILURE_NONE = 0,
+	FAILURE_TRANSIENT = 1,
+	FAILURE_SIGNAL = 2,
+	FAILURE_STATUS = 3,
+	FAILURE_OUTPUT = 4,
+	FAILURE_RESULT = 5,
+	FAILURES = 6
+};
+
+/**
+ * \enum PortfolioArm
+ * \brief Enum to define the search algorithms of the portfolio.
+ */
+enum PortfolioArm
+{
+	PORTFOLIO_ARM_MONTE_CARLO = 0,
+	PORTFOLIO_ARM_REFINE = 1,
+	PORTFOLIO_ARM_LOCAL = 2,
+	PORTFOLIO_ARM_EVOLUTION = 3,
+	PORTFOLIO_ARMS = 4
+};
+
+/**
+ * \enum ShardMode
+ * \brief Enum to define how to split the simulations between the shards.
+ */
+enum ShardMode
+{
+	SHARD_MODE_INTERLEAVED = 0,
+	SHARD_MODE_BLOCKED = 1
 };
 
 /**
@@ -83,6 +161,16 @@ typedef struct
  * \brief Array of variable names.
  * \var format
  * \brief Array of variable formats.
+ * \var chain
+ * \brief Name of the MCMC chain file.
+ * \var population
+ * \brief Name of the ABC-SMC final population file.
+ * \var results
+ * \brief Name of the sorted results file.
+ * \var store
+ * \brief Name of the store file of the experiment objective function values.
+ * \var hash
+ * \brief Array of experiment identities.
  * \var nvariables
  * \brief Variables number.
  * \var nexperiments
@@ -93,26 +181,51 @@ typedef struct
  * \brief Simulations number per experiment.
  * \var algorithm
  * \brief Algorithm number
+ * \var multi_experiment
+ * \brief Mode to simulate all the experiments in a single simulator run.
+ * \var ngroups
+ * \brief Number of variable groups.
+ * \var group
+ * \brief Array of first variable numbers of every group (and the variables
+ *   number at the end).
  * \var nsweeps
- * \brief Array of sweeps of the sweep algorithm.
+ * \brief Array of sweeps of the sweep and block-coordinate algorithms.
  * \var nstart
  * \brief Beginning simulation number of the task.
  * \var nend
  * \brief Ending simulation number of the task.
+ * \var nnext
+ * \brief Next simulation number to perform on the task.
+ * \var nshards
+ * \brief Number of shards of the simulations (1 without shards).
+ * \var shard
+ * \brief Shard number of the process.
+ * \var shard_mode
+ * \brief Mode to split the simulations between the shards.
+ * \var nevaluated
+ * \brief Number of performed simulations on the task.
+ * \var stop
+ * \brief 1 to stop performing simulations on the task, 0 otherwise.
+ * \var nstop
+ * \brief Number of performed simulations to check again the stopping rule.
  * \var nthreads
  * \brief Number of threads.
- * \var thread
- * \brief Array of simulation numbers to calculate on the thread.
  * \var niterations
  * \brief Number of algorithm iterations
  * \var nbests
  * \brief Number of best simulations.
+ * \var nbootstraps
+ * \brief Number of bootstrap replicates of the Sobol indices.
  * \var nsaveds
  * \brief Number of saved simulations.
  * \var simulation_best
- * \brief Array of best simulation numbers.
+ * \brief Array of best simulation numbers (unsorted, see calibrate_best_sort).
  * \var value
  * \brief Array of variable values.
+ * \var error
+ * \brief Array of objective function values.
+ * \var value_best
+ * \brief Array of best variable values.
  * \var rangemin
  * \brief Array of minimum variable values.
  * \var rangemax
@@ -121,21 +234,191 @@ typedef struct
  * \brief Array of best minimum errors.
  * \var tolerance
  * \brief Algorithm tolerance.
+ * \var stop_probability
+ * \brief Probability of improving the best more than the tolerance with the \
+ *   remaining simulations to stop the Monte-Carlo algorithm (0 to disable).
+ * \var noise
+ * \brief Noise scale of the MCMC likelihood.
+ * \var stretch
+ * \brief Scale of the MCMC stretch moves.
+ * \var quantile
+ * \brief Quantile of the ABC-SMC population distances to get the next \
+ *   tolerance.
+ * \var nsteady
+ * \brief Number of columns of the simulator output monitored to detect the \
+ *   steady state (0 to disable the monitor).
+ * \var steady_column
+ * \brief Array of monitored column numbers (starting on 0).
+ * \var steady_window
+ * \brief Number of output rows of the steady state window.
+ * \var steady_action
+ * \brief Action to do when the steady state is reached.
+ * \var nsteady_stops
+ * \brief Number of simulations stopped on the steady state.
+ * \var budget
+ * \brief Number of stored candidates to simulate on the not stored
+ *   experiments (0 to perform the algorithm).
+ * \var nreused
+ * \brief Number of stored experiment objective function values reused.
+ * \var nstored
+ * \brief Number of experiment objective function values added to the store.
+ * \var retries
+ * \brief Maximum number of retries of a simulation with transient failures.
+ * \var retry
+ * \brief Queue of simulation numbers to retry.
+ * \var retry_thread
+ * \brief Queue of threads where the simulations to retry failed.
+ * \var nretry
+ * \brief Number of simulations to retry.
+ * \var attempt
+ * \brief Array of retries of the simulations of the task.
+ * \var nfailures
+ * \brief Array of numbers of failed experiment evaluations of every class.
+ * \var nretried
+ * \brief Number of retried simulations.
+ * \var nexhausted
+ * \brief Number of simulations with transient failures after all retries.
+ * \var nobservations
+ * \brief Number of kept observed simulations of the failure classifier.
+ * \var nobserved
+ * \brief Number of observed simulations of the failure classifier.
+ * \var failed
+ * \brief Array of observed simulation failures (1 on failure, 0 otherwise).
+ * \var nfailed
+ * \brief Number of observed failed simulations.
+ * \var outcome
+ * \brief Array of outcomes of the simulations of the task (0 not performed or
+ *   screened, 1 succeeded, 2 failed).
+ * \var nscreened
+ * \brief Number of new simulations skipped by the failure classifier.
+ * \var screened
+ * \brief Array of the simulations of the last range skipped by the failure
+ *   classifier on any task (1 if skipped, 0 otherwise).
+ * \var nactive
+ * \brief Number of threads taking simulations.
+ * \var paused
+ * \brief 1 if the simulations dispatch is paused, 0 otherwise.
+ * \var halt
+ * \brief 1 to stop the algorithm, 0 otherwise.
+ * \var nbatches
+ * \brief Number of performed batches of simulations.
+ * \var ncancelled
+ * \brief Number of simulations cancelled by the steered bounds.
+ * \var npriority
+ * \brief Number of variables with a priority interval.
+ * \var taken
+ * \brief Array of flags of the dispatched simulations of the task.
+ * \var control_end
+ * \brief 1 to end the control thread, 0 otherwise.
+ * \var control_socket
+ * \brief Control socket descriptor.
+ * \var steady_tolerance
+ * \brief Maximum relative change on the window to reach the steady state.
+ * \var steady_end
+ * \brief Final simulated time.
+ * \var steady_saved
+ * \brief Simulated time saved by the steady state stops.
+ * \var penalty
+ * \brief Objective function value of the failed experiment evaluations.
+ * \var observation
+ * \brief Array of normalized variable values of the observed simulations.
+ * \var failure_threshold
+ * \brief Predicted failure probability to skip a new simulation (1 to
+ *   disable the failure classifier).
+ * \var failure_explore
+ * \brief Probability to perform a new simulation predicted to fail.
+ * \var bound_min
+ * \brief Array of steered minimum variable values.
+ * \var bound_max
+ * \brief Array of steered maximum variable values.
+ * \var priority_min
+ * \brief Array of minimum variable values of the priority region.
+ * \var priority_max
+ * \brief Array of maximum variable values of the priority region.
+ * \var rng_failure
+ * \brief Pseudo-random numbers generator of the failure classifier.
+ * \var file_control
+ * \brief Log file of the steering commands.
+ * \var thread_control
+ * \brief Control thread.
+ * \var sampler
+ * \brief Sampler plugin data pointer.
+ * \var control
+ * \brief Control socket name.
+ * \var control_log
+ * \brief Log file name of the steering commands.
+ * \var command
+ * \brief Queued steering commands (one per line).
+ * \var library
+ * \brief Shared library file name of the sampler plugin.
+ * \var plugin_parameters
+ * \brief Parameters string of the sampler plugin.
+ * \var plugin_state
+ * \brief State file name of the sampler plugin.
  * \var file
  * \brief Matrix of input template files.
+ * \var file_store
+ * \brief Store file to add the experiment objective function values.
+ * \var stored
+ * \brief Hash table of the stored experiment objective function values.
+ * \var heap
+ * \brief Binary heap of the slots of the bests, the worst on the top.
+ * \var sorted
+ * \brief 1 if the bests are sorted, 0 otherwise.
+ * \var mpi_group
+ * \brief Number of MPI tasks of a simulator group (0 to run the simulator as
+ *   a program).
  * \var mpi_rank
  * \brief Number of MPI task.
  * \var mpi_tasks
  * \brief Total number of MPI tasks.
+ * \var mpi_thread
+ * \brief Thread support level of MPI.
+ * \var mpi_ngroups
+ * \brief Number of MPI simulator groups.
+ * \var mpi_free
+ * \brief Array of free MPI simulator groups.
+ * \var mpi_nfree
+ * \brief Number of free MPI simulator groups.
+ * \var mpi_comm
+ * \brief MPI communicator of the calibrator tasks, or of the simulator group
+ *   on the tasks of the groups.
+ * \var mpi_module
+ * \brief Simulator library of the MPI groups.
+ * \var mpi_simulator
+ * \brief Simulator function of the MPI groups.
  */
-	char *simulator, *evaluator, **experiment, **template[4], **label, **format;
+	char *simulator, *evaluator, **experiment, **template[4], **label, **format,
+		*chain, *population, *results, *store, **hash, *control, *control_log,
+		*command, *library, *plugin_parameters, *plugin_state;
 	unsigned int nvariables, nexperiments, ninputs, nsimulations, algorithm,
-		*nsweeps, nstart, nend, nthreads, *thread, niterations, nbests, nsaveds,
-		*simulation_best;
-	double *value, *rangemin, *rangemax, *error_best, tolerance;
+		multi_experiment, ngroups, *group, *nsweeps, nstart, nend, nnext,
+		nshards, shard, shard_mode, nevaluated, stop, nstop, nthreads,
+		niterations, nbests, nbootstraps, nsaveds, *simulation_best, nsteady,
+		*steady_column, steady_window, steady_action, nsteady_stops, budget,
+		nreused, nstored, retries, *retry, *retry_thread, nretry, *attempt,
+		nfailures[FAILURES], nretried, nexhausted, nobservations, nobserved,
+		*failed, nfailed, *outcome, nscreened, *screened, nactive, paused, halt,
+		nbatches, ncancelled, npriority, *taken, control_end, mpi_group, *heap,
+		sorted;
+	int control_socket;
+	double *value, *error, *value_best, *rangemin, *rangemax, *error_best,
+		tolerance, stop_probability, noise, stretch, quantile, steady_tolerance,
+		steady_end, steady_saved, penalty, *observation, failure_threshold,
+		failure_explore, *bound_min, *bound_max, *priority_min, *priority_max;
 	GMappedFile **file[4];
+	FILE *file_store;
+	GHashTable *stored;
+	gsl_rng *rng_failure;
+	FILE *file_control;
+	GThread *thread_control;
+	struct Sampler *sampler;
 #ifdef HAVE_MPI
-	int mpi_rank, mpi_tasks;
+	int mpi_rank, mpi_tasks, mpi_thread;
+	unsigned int mpi_ngroups, *mpi_free, mpi_nfree;
+	MPI_Comm mpi_comm;
+	GModule *mpi_module;
+	int (*mpi_simulator)(MPI_Comm, int, char**);
 #endif
 } Calibrate;
 
@@ -150,11 +433,198 @@ typedef struct
  * \brief Thread number.
  * \var calibrate
  * \brief Calibration data pointer.
+ * \var data
+ * \brief Algorithm data pointer.
  */
 	unsigned int thread;
 	Calibrate *calibrate;
+	void *data;
 } ParallelData;
 
+/**
+ * \struct Abc
+ * \brief Struct to define the ABC-SMC population data.
+ */
+typedef struct
+{
+/**
+ * \var first
+ * \brief First particle number of the task.
+ * \var naccepted
+ * \brief Number of accepted particles of the task.
+ * \var ntarget
+ * \brief Number of particles to accept on the task.
+ * \var ntrials
+ * \brief Number of proposals of the task.
+ * \var nmaximum
+ * \brief Maximum number of proposals of the task.
+ * \var nrunning
+ * \brief Number of proposals in simulation on the task.
+ * \var open
+ * \brief 1 if the population takes proposals, 0 otherwise.
+ * \var end
+ * \brief 1 to finish the threads, 0 otherwise.
+ * \var iteration
+ * \brief Population number.
+ * \var epsilon
+ * \brief Population tolerance.
+ * \var particle
+ * \brief Array of particle variable values.
+ * \var particle_old
+ * \brief Array of particle variable values of the previous population.
+ * \var weight
+ * \brief Array of particle weights.
+ * \var weight_old
+ * \brief Array of cumulative particle weights of the previous population.
+ * \var distance
+ * \brief Array of particle distances (objective function values).
+ * \var sigma
+ * \brief Array of standard deviations of the perturbation kernel.
+ * \var rng
+ * \brief Pseudo-random numbers generator of the task.
+ */
+	unsigned int first, naccepted, ntarget, ntrials, nmaximum, nrunning, open,
+		end, iteration;
+	double epsilon, *particle, *particle_old, *weight, *weight_old, *distance,
+		*sigma;
+	gsl_rng *rng;
+} Abc;
+
+/**
+ * \struct Portfolio
+ * \brief Struct to define the portfolio bandit data.
+ */
+typedef struct
+{
+/**
+ * \var pulls
+ * \brief Array of discounted numbers of simulations of every arm.
+ * \var rewards
+ * \brief Array of discounted rewards of every arm.
+ * \var slots
+ * \brief Array of simulation slots of every arm in the current batch.
+ * \var step
+ * \brief Relative standard deviation of the local search.
+ * \var nevaluations
+ * \brief Array of numbers of performed simulations of every arm.
+ * \var nhits
+ * \brief Array of numbers of cached proposals of every arm.
+ * \var nscreened
+ * \brief Array of numbers of proposals of every arm drawn again because the
+ *   failure classifier predicts a failure.
+ * \var nentries
+ * \brief Array of numbers of simulations of every arm entering in the bests.
+ * \var nimprovements
+ * \brief Array of numbers of improvements of the best of every arm.
+ */
+	double pulls[PORTFOLIO_ARMS], rewards[PORTFOLIO_ARMS],
+		slots[PORTFOLIO_ARMS], step;
+	unsigned int nevaluations[PORTFOLIO_ARMS], nhits[PORTFOLIO_ARMS],
+		nscreened[PORTFOLIO_ARMS], nentries[PORTFOLIO_ARMS],
+		nimprovements[PORTFOLIO_ARMS];
+} Portfolio;
+
+/**
+ * \struct Sampler
+ * \brief Struct to define a sampler plugin.
+ */
+typedef struct Sampler
+{
+/**
+ * \var module
+ * \brief Shared library module.
+ * \var data
+ * \brief Sampler data pointer.
+ * \var info
+ * \brief Calibration data passed to the sampler.
+ * \var abi
+ * \brief Function to get the version of the interface of the plugin.
+ * \var new
+ * \brief Function to create the sampler.
+ * \var propose
+ * \brief Function to propose simulations.
+ * \var observe
+ * \brief Function to report the objective function values of simulations.
+ * \var save
+ * \brief Function to save the sampler state.
+ * \var restore
+ * \brief Function to restore a saved sampler state.
+ * \var free
+ * \brief Function to free the memory of the sampler.
+ * \var nbatches
+ * \brief Number of observed batches.
+ * \var nsimulations
+ * \brief Number of observed simulations.
+ * \var npending
+ * \brief Number of proposed simulations not observed yet on the asynchronous
+ *   mode.
+ * \var nsaveds
+ * \brief Number of restored bests.
+ * \var simulation_best
+ * \brief Array of restored best simulation numbers.
+ * \var error_best
+ * \brief Array of restored best objective function values.
+ * \var value_best
+ * \brief Array of restored best variable values.
+ */
+	GModule *module;
+	void *data;
+	SamplerInfo info;
+	unsigned int (*abi)(void);
+	void* (*new)(const SamplerInfo*);
+	unsigned int (*propose)(void*, double*, unsigned int);
+	void (*observe)(void*, const double*, const double*, unsigned int);
+	int (*save)(void*, FILE*);
+	int (*restore)(void*, FILE*);
+	void (*free)(void*);
+	unsigned int nbatches, nsimulations, npending, nsaveds, *simulation_best;
+	double *error_best, *value_best;
+} Sampler;
+
+/**
+ * \struct Result
+ * \brief Struct to sort the simulation results.
+ */
+typedef struct
+{
+/**
+ * \var error
+ * \brief Objective function value.
+ * \var simulation
+ * \brief Simulation number.
+ */
+	double error;
+	unsigned int simulation;
+} Result;
+
+/**
+ * \struct ResultsFile
+ * \brief Struct to read a sorted results file.
+ */
+typedef struct
+{
+/**
+ * \var file
+ * \brief File pointer.
+ * \var format
+ * \brief Array of c-string formats of the variables.
+ * \var value
+ * \brief Array of variable values of the current simulation.
+ * \var error
+ * \brief Objective function value of the current simulation.
+ * \var nvariables
+ * \brief Variables number.
+ * \var nbests
+ * \brief Bests number.
+ * \var simulation
+ * \brief Current simulation number.
+ */
+	FILE *file;
+	char **format;
+	double *value, error;
+	unsigned int nvariables, nbests, simulation;
+} ResultsFile;
+
 /**
  * \var rng
  * \brief Pseudo-random numbers generator struct.
@@ -168,7 +638,23 @@ gsl_rng *rng;
 GMutex mutex;
 
 /**
- * \fn void calibrate_input(Calibrate *calibrate, unsigned int simulation, \
+ * \var cond
+ * \brief Condition struct to wait while the simulations dispatch is paused.
+ */
+GCond cond;
+
+#ifdef HAVE_MPI
+
+/**
+ * \var mutex_group
+ * \brief Mutex struct to take the free MPI simulator groups.
+ */
+GMutex mutex_group;
+
+#endif
+
+/**
+ * \fn int calibrate_input(Calibrate *calibrate, unsigned int simulation, \
  *   char *input, GMappedFile *template)
  * \brief Function to write the simulation input file.
  * \param calibrate
@@ -179,12 +665,14 @@ GMutex mutex;
  * \brief Input file name.
  * \param template
  * \brief Template of the input file name.
+ * \return 1 on success, 0 on error writing the file.
  */
-void calibrate_input(Calibrate *calibrate, unsigned int simulation,
+int calibrate_input(Calibrate *calibrate, unsigned int simulation,
 	char *input, GMappedFile *template)
 {
+	int ok;
 	unsigned int i;
-	char buffer[32], value[32], *buffer2, *buffer3, *content;
+	char buffer[32], value[VALUE_LENGTH], *buffer2, *buffer3, *content;
 	FILE *file;
 	gsize length;
 	GRegex *regex;
@@ -200,6 +688,7 @@ printf("calibrate_input: start\n");
 printf("calibrate_input: length=%lu\ncontent:\n%s", length, content);
 #endif
 	file = fopen(input, "w");
+	if (!file) return 0;
 
 	// Parsing template
 	for (i = 0; i < calibrate->nvariables; ++i)
@@ -228,7 +717,7 @@ printf("calibrate_input: buffer2\n%s", buffer2);
 		length = strlen(buffer2);
 		snprintf(buffer, 32, "@value%u@", i + 1);
 		regex = g_regex_new(buffer, 0, 0, NULL);
-		snprintf(value, 32, calibrate->format[i],
+		snprintf(value, VALUE_LENGTH, calibrate->format[i],
 		calibrate->value[simulation * calibrate->nvariables + i]);
 
 #if DEBUG
@@ -241,514 +730,4989 @@ printf("calibrate_parse: value=%s\n", value);
 	}
 
 	// Saving input file
-	fwrite(buffer3, strlen(buffer3), sizeof(char), file);
+	length = strlen(buffer3);
+	ok = (fwrite(buffer3, sizeof(char), length, file) == length);
 	g_free(buffer3);
-	fclose(file);
+	ok = !fclose(file) && ok;
 
 #if DEBUG
 printf("calibrate_input: end\n");
 #endif
+	return ok;
 }
 
 /**
- * \fn double calibrate_parse(Calibrate *calibrate, unsigned int simulation, \
- *   unsigned int experiment)
- * \brief Function to parse input files, simulating and calculating the \
- *   objective function.
+ * \fn int calibrate_steady(Calibrate *calibrate, double *window, \
+ *   unsigned int nrows)
+ * \brief Function to check if the monitored columns reached the steady state.
  * \param calibrate
  * \brief Calibration data.
- * \param simulation
- * \brief Simulation number.
- * \param experiment
- * \brief Experiment number.
- * \return Objective function value.
+ * \param window
+ * \brief Circular buffer of the last monitored column values.
+ * \param nrows
+ * \brief Number of read rows.
+ * \return 1 on steady state, 0 otherwise.
  */
-double calibrate_parse(Calibrate *calibrate, unsigned int simulation,
-	unsigned int experiment)
+int calibrate_steady(Calibrate *calibrate, double *window, unsigned int nrows)
 {
-	unsigned int i;
-	double e;
-	char buffer[512], input[4][32], output[32], result[32];
-	FILE *file_result;
+	unsigned int i, j, last;
+	double x;
+	if (nrows < calibrate->steady_window) return 0;
+	last = (nrows - 1) % calibrate->steady_window;
+	for (i = 0; i < calibrate->nsteady; ++i)
+	{
+		x = window[last * calibrate->nsteady + i];
+		for (j = 0; j < calibrate->steady_window; ++j)
+			if (fabs(window[j * calibrate->nsteady + i] - x)
+				> calibrate->steady_tolerance * fabs(x))
+				return 0;
+	}
+	return 1;
+}
+
+/**
+ * \fn int calibrate_monitor(Calibrate *calibrate, pid_t pid, char *output)
+ * \brief Function to tail the simulator output file while the simulator runs,
+ *   stopping it when the steady state is reached. Only regular files are
+ *   tailed: on other outputs (as pipes) the simulator is waited for without
+ *   monitoring. The rows are read whole, whatever their length.
+ * \param calibrate
+ * \brief Calibration data.
+ * \param pid
+ * \brief Simulator process identifier.
+ * \param output
+ * \brief Output file name.
+ * \return Simulator wait status (0 if stopped on the steady state, the kill
+ *   status if the output file can not be completed).
+ */
+int calibrate_monitor(Calibrate *calibrate, pid_t pid, char *output)
+{
+	unsigned int i, nrows, ncolumns, steady;
+	int status;
+	long position;
+	size_t size, size_last, length;
+	double t, tlast, dt, *row,
+		window[calibrate->steady_window * calibrate->nsteady];
+	char *buffer, *last, *c, *c2;
+	struct stat st;
+	FILE *file;
 
 #if DEBUG
-printf("calibrate_parse: start\n");
-printf("calibrate_parse: simulation=%u experiment=%u\n", simulation,
-experiment);
+printf("calibrate_monitor: start\n");
 #endif
 
-	// Opening input files
-	for (i = 0; i < calibrate->ninputs; ++i)
+	// Columns to parse on each row
+	for (i = ncolumns = 0; i < calibrate->nsteady; ++i)
+		if (calibrate->steady_column[i] >= ncolumns)
+			ncolumns = calibrate->steady_column[i] + 1;
+	row = (double*)alloca(ncolumns * sizeof(double));
+
+	// Tailing the output file
+	file = NULL;
+	buffer = last = NULL;
+	size = size_last = 0;
+	nrows = steady = 0;
+	position = 0;
+	t = tlast = 0.;
+	while (!steady)
 	{
-		snprintf(&input[i][0], 32, "input-%u-%u-%u", i, simulation, experiment);
-#if DEBUG
-printf("calibrate_parse: i=%u input=%s\n", i, &input[i][0]);
-#endif
-		calibrate_input(calibrate, simulation, &input[i][0],
-			calibrate->file[i][experiment]);
+		if (waitpid(pid, &status, WNOHANG) == pid) break;
+		if (!file)
+		{
+			if (!stat(output, &st) && !S_ISREG(st.st_mode))
+			{
+				waitpid(pid, &status, 0);
+				break;
+			}
+			file = fopen(output, "r");
+		}
+		if (file)
+		{
+			clearerr(file);
+			while (getline(&buffer, &size, file) > 0)
+			{
+				// Waiting to complete the line
+				if (buffer[strlen(buffer) - 1] != '\n')
+				{
+					fseek(file, position, SEEK_SET);
+					break;
+				}
+				position = ftell(file);
+
+				// Parsing the row (non numeric rows are ignored)
+				for (i = 0, c = buffer; i < ncolumns; ++i)
+				{
+					row[i] = strtod(c, &c2);
+					if (c2 == c) break;
+					for (c = c2; *c == ',' || *c == ';'; ++c);
+				}
+				if (i < ncolumns) continue;
+				tlast = t;
+				t = row[0];
+				for (i = 0; i < calibrate->nsteady; ++i)
+					window[(nrows % calibrate->steady_window)
+						* calibrate->nsteady + i]
+						= row[calibrate->steady_column[i]];
+
+				// Keeping the last row, swapping the buffers
+				c = last;
+				last = buffer;
+				buffer = c;
+				length = size_last;
+				size_last = size;
+				size = length;
+				++nrows;
+				steady = calibrate_steady(calibrate, window, nrows);
+				if (steady) break;
+			}
+		}
+		if (!steady) g_usleep(STEADY_INTERVAL);
 	}
-	for (; i < 4; ++i) snprintf(&input[i][0], 32, "");
-#if DEBUG
-printf("calibrate_parse: parsing end\n");
-#endif
 
-	// Performing the simulation
-	snprintf(output, 32, "output-%u-%u", simulation, experiment);
-	snprintf(result, 32, "result-%u-%u", simulation, experiment);
-	snprintf(buffer, 512, "./%s %s %s %s %s %s", calibrate->simulator,
-		&input[0][0], &input[1][0], &input[2][0], &input[3][0], output);
+	if (steady)
+	{
 #if DEBUG
-printf("calibrate_parse: %s\n", buffer);
+printf("calibrate_monitor: steady state at t=%lg\n", t);
 #endif
-	system(buffer);
+		if (calibrate->steady_action == STEADY_ACTION_SIGNAL)
+		{
+			// Asking the simulator to finish
+			kill(pid, SIGTERM);
+			waitpid(pid, &status, 0);
+		}
+		else
+		{
+			// Killing the simulator and completing the output with the last
+			// state (a kill failure if the output can not be completed)
+			kill(pid, SIGKILL);
+			waitpid(pid, &status, 0);
+			fclose(file);
+			file = NULL;
+			if (truncate(output, position) || !(file = fopen(output, "a")))
+				steady = 0;
+			else
+			{
+				dt = t - tlast;
+				strtod(last, &c);
+				if (dt > 0.)
+					for (i = 1; t + i * dt
+						<= calibrate->steady_end + 0.5 * dt; ++i)
+						fprintf(file, "%.15lg%s", t + i * dt, c);
+			}
+		}
+	}
+	if (steady)
+	{
+		status = 0;
+		g_mutex_lock(&mutex);
+		++calibrate->nsteady_stops;
+		if (calibrate->steady_end > t)
+			calibrate->steady_saved += calibrate->steady_end - t;
+		g_mutex_unlock(&mutex);
+	}
+	if (file) fclose(file);
+	free(last);
+	free(buffer);
 
-	// Checking the objective value function
-	snprintf(buffer, 512, "./%s %s %s %s", calibrate->evaluator, output,
-		calibrate->experiment[experiment], result);
 #if DEBUG
-printf("calibrate_parse: %s\n", buffer);
+printf("calibrate_monitor: end\n");
 #endif
-	system(buffer);
-	file_result = fopen(result, "r");
-	e = atof(fgets(buffer, 512, file_result));
-	fclose(file_result);
 
-	// Removing files
-#if !DEBUG
-	snprintf(buffer, 512, "rm %s %s %s %s %s %s", &input[0][0], &input[1][0],
-		&input[2][0], &input[3][0], output, result);
-	system(buffer);
-#endif
+	return status;
+}
 
-#if DEBUG
-printf("calibrate_parse: end\n");
-#endif
+#ifdef HAVE_MPI
 
-	// Returning the objective function
-	return e;
+/**
+ * \fn char** calibrate_arguments(char *command, int *n)
+ * \brief Function to split a command line in arguments by the spaces, so the
+ *   arguments can not contain spaces.
+ * \param command
+ * \brief Command line.
+ * \param n
+ * \brief Pointer to the number of arguments.
+ * \return NULL terminated array of arguments (freed with g_strfreev).
+ */
+char** calibrate_arguments(char *command, int *n)
+{
+	unsigned int i, j;
+	char **argument;
+	argument = g_strsplit(command, " ", 0);
+	for (i = j = 0; argument[i]; ++i)
+		if (argument[i][0]) argument[j++] = argument[i];
+		else g_free(argument[i]);
+	argument[j] = NULL;
+	*n = j;
+	return argument;
 }
 
 /**
- * \fn void calibrate_best_thread(Calibrate *calibrate, \
- *   unsigned int simulation, double value)
- * \brief Function to save the bests simulations of a thread.
+ * \fn int calibrate_group_run(Calibrate *calibrate, char *command)
+ * \brief Function to run the simulator on a free MPI simulator group. There
+ *   is a group per thread, so a free group is always available.
  * \param calibrate
  * \brief Calibration data.
- * \param simulation
- * \brief Simulation number.
- * \param value
- * \brief Objective function value.
+ * \param command
+ * \brief Simulator command line.
+ * \return Simulator wait status, as returned by system.
  */
-void calibrate_best_thread(Calibrate *calibrate, unsigned int simulation,
-	double value)
+int calibrate_group_run(Calibrate *calibrate, char *command)
 {
-	unsigned int i, j;
-	double e;
+	unsigned int i;
+	int k;
 #if DEBUG
-printf("calibrate_best_thread: start\n");
+printf("calibrate_group_run: start\n");
 #endif
-	if (calibrate->nsaveds < calibrate->nbests
-		|| value < calibrate->error_best[calibrate->nsaveds - 1])
-	{
-		g_mutex_lock(&mutex);
-		if (calibrate->nsaveds < calibrate->nbests) ++calibrate->nsaveds;
-		calibrate->error_best[calibrate->nsaveds - 1] = value;
-		calibrate->simulation_best[calibrate->nsaveds - 1] = simulation;
-		for (i = calibrate->nsaveds; --i;)
-		{
-			if (calibrate->error_best[i] < calibrate->error_best[i - 1])
-			{
-				j = calibrate->simulation_best[i];
-				e = calibrate->error_best[i];
-				calibrate->simulation_best[i]
-					= calibrate->simulation_best[i - 1];
-				calibrate->error_best[i] = calibrate->error_best[i - 1];
-				calibrate->simulation_best[i - 1] = j;
-				calibrate->error_best[i - 1] = e;
-			}
-			else break;
-		}
-		g_mutex_unlock(&mutex);
-	}
+
+	// Taking a free group
+	g_mutex_lock(&mutex_group);
+	i = calibrate->mpi_free[--calibrate->mpi_nfree];
+	g_mutex_unlock(&mutex_group);
+
+	// Sending the command line to the first task of the group and waiting for
+	// the value returned by the simulator
+	MPI_Send(command, strlen(command) + 1, MPI_CHAR,
+		1 + i * calibrate->mpi_group, 0, MPI_COMM_WORLD);
+	MPI_Recv(&k, 1, MPI_INT, 1 + i * calibrate->mpi_group, 0, MPI_COMM_WORLD,
+		MPI_STATUS_IGNORE);
+
+	// Freeing the group
+	g_mutex_lock(&mutex_group);
+	calibrate->mpi_free[calibrate->mpi_nfree++] = i;
+	g_mutex_unlock(&mutex_group);
 #if DEBUG
-printf("calibrate_best_thread: end\n");
+printf("calibrate_group_run: end\n");
 #endif
+	return (k & 0xff) << 8;
 }
 
 /**
- * \fn void calibrate_best_sequential(Calibrate *calibrate, \
- *   unsigned int simulation, double value)
- * \brief Function to save the bests simulations.
+ * \fn void calibrate_group(Calibrate *calibrate)
+ * \brief Function to run the simulations sent by the calibrator task on a
+ *   MPI simulator group, until an empty command line is received.
  * \param calibrate
  * \brief Calibration data.
- * \param simulation
- * \brief Simulation number.
- * \param value
- * \brief Objective function value.
  */
-void calibrate_best_sequential(Calibrate *calibrate, unsigned int simulation,
-	double value)
+void calibrate_group(Calibrate *calibrate)
 {
-	unsigned int i, j;
-	double e;
+	int k, n, rank;
+	char *buffer, **argument;
+	MPI_Status status;
 #if DEBUG
-printf("calibrate_best_sequential: start\n");
+printf("calibrate_group: start\n");
 #endif
-	if (calibrate->nsaveds < calibrate->nbests
-		|| value < calibrate->error_best[calibrate->nsaveds - 1])
+	MPI_Comm_rank(calibrate->mpi_comm, &rank);
+	for (;;)
 	{
-		if (calibrate->nsaveds < calibrate->nbests) ++calibrate->nsaveds;
-		calibrate->error_best[calibrate->nsaveds - 1] = value;
-		calibrate->simulation_best[calibrate->nsaveds - 1] = simulation;
-		for (i = calibrate->nsaveds; --i;)
+		// Receiving the command line on the first task of the group and sharing
+		// it with the group
+		if (!rank)
 		{
-			if (calibrate->error_best[i] < calibrate->error_best[i - 1])
-			{
-				j = calibrate->simulation_best[i];
-				e = calibrate->error_best[i];
-				calibrate->simulation_best[i]
-					= calibrate->simulation_best[i - 1];
-				calibrate->error_best[i] = calibrate->error_best[i - 1];
-				calibrate->simulation_best[i - 1] = j;
-				calibrate->error_best[i - 1] = e;
-			}
-			else break;
+			MPI_Probe(0, 0, MPI_COMM_WORLD, &status);
+			MPI_Get_count(&status, MPI_CHAR, &n);
+		}
+		MPI_Bcast(&n, 1, MPI_INT, 0, calibrate->mpi_comm);
+		buffer = (char*)g_malloc(n + 1);
+		if (!rank)
+			MPI_Recv(buffer, n, MPI_CHAR, 0, 0, MPI_COMM_WORLD,
+				MPI_STATUS_IGNORE);
+		if (!n)
+		{
+			g_free(buffer);
+			break;
 		}
+		MPI_Bcast(buffer, n, MPI_CHAR, 0, calibrate->mpi_comm);
+
+		// Running the simulator and returning its value
+		argument = calibrate_arguments(buffer, &k);
+		g_free(buffer);
+		k = calibrate->mpi_simulator(calibrate->mpi_comm, k, argument);
+		g_strfreev(argument);
+		if (!rank) MPI_Send(&k, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
 	}
 #if DEBUG
-printf("calibrate_best_sequential: end\n");
+printf("calibrate_group: end\n");
 #endif
 }
 
 /**
- * \fn void* calibrate_thread(ParallelData *data)
- * \brief Function to calibrate on a thread.
- * \param data
- * \brief Function data.
- * \return NULL
+ * \fn void calibrate_group_close(Calibrate *calibrate)
+ * \brief Function to stop the MPI simulator groups and to free their data.
+ * \param calibrate
+ * \brief Calibration data.
  */
-void* calibrate_thread(ParallelData *data)
+void calibrate_group_close(Calibrate *calibrate)
 {
-	unsigned int i, j, thread;
-	double e;
-	Calibrate *calibrate;
-#if DEBUG
-printf("calibrate_thread: start\n");
-#endif
-	thread = data->thread;
-	calibrate = data->calibrate;
-#if DEBUG
-printf("calibrate_thread: thread=%u start=%u end=%u\n", thread,
-calibrate->thread[thread], calibrate->thread[thread + 1]);
-#endif
-	for (i = calibrate->thread[thread]; i < calibrate->thread[thread + 1]; ++i)
+	unsigned int i;
+	if (!calibrate->mpi_rank)
 	{
-		e = 0.;
-		for (j = 0; j < calibrate->nexperiments; ++j)
-			e += calibrate_parse(calibrate, i, j);
-		calibrate_best_thread(calibrate, i, e);
-#if DEBUG
-printf("calibrate_thread: i=%u e=%lg\n", i, e);
-#endif
+		for (i = 0; i < calibrate->mpi_ngroups; ++i)
+			MPI_Send(NULL, 0, MPI_CHAR, 1 + i * calibrate->mpi_group, 0,
+				MPI_COMM_WORLD);
+		free(calibrate->mpi_free);
 	}
-#if DEBUG
-printf("calibrate_thread: end\n");
-#endif
-	g_thread_exit(NULL);
-	return NULL;
+	MPI_Comm_free(&calibrate->mpi_comm);
+	g_module_close(calibrate->mpi_module);
 }
 
+#endif
+
 /**
- * \fn void calibrate_sequential(Calibrate *calibrate)
- * \brief Function to calibrate sequentially.
+ * \fn int calibrate_simulate(Calibrate *calibrate, char *command, \
+ *   char *output)
+ * \brief Function to run the simulator, on a MPI simulator group or
+ *   monitoring the steady state if required.
  * \param calibrate
- * \brief Calibration data pointer.
+ * \brief Calibration data.
+ * \param command
+ * \brief Simulator command line.
+ * \param output
+ * \brief Output file name.
+ * \return Simulator wait status.
  */
-void calibrate_sequential(Calibrate *calibrate)
+int calibrate_simulate(Calibrate *calibrate, char *command, char *output)
 {
-	unsigned int i, j;
-	double e;
-#if DEBUG
-printf("calibrate_sequential: start\n");
+	pid_t pid;
+	char *buffer;
+#ifdef HAVE_MPI
+	if (calibrate->mpi_group) return calibrate_group_run(calibrate, command);
 #endif
-	for (i = 0; i < calibrate->nsimulations; ++i)
+	if (!calibrate->nsteady) return system(command);
+	buffer = (char*)alloca(strlen(command) + 6);
+	sprintf(buffer, "exec %s", command);
+	pid = fork();
+	if (pid < 0) return -1;
+	if (!pid)
 	{
-		e = 0.;
-		for (j = 0; j < calibrate->nexperiments; ++j)
-			e += calibrate_parse(calibrate, i, j);
-		calibrate_best_sequential(calibrate, i, e);
-#if DEBUG
-printf("calibrate_sequential: i=%u e=%lg\n", i, e);
-#endif
+		execl("/bin/sh", "sh", "-c", buffer, (char*)NULL);
+		_exit(127);
+	}
+	return calibrate_monitor(calibrate, pid, output);
+}
+
+/**
+ * \fn unsigned int calibrate_failure(int status)
+ * \brief Function to classify the wait status of a program. The failures to
+ *   run it, the kills by the system or by the user (as out of memory kills),
+ *   the file size limit and the exit status 75 (temporary failure) are
+ *   transient failures.
+ * \param status
+ * \brief Wait status.
+ * \return Failure class.
+ */
+unsigned int calibrate_failure(int status)
+{
+	int signal;
+	if (status == -1) return FAILURE_TRANSIENT;
+	if (WIFSIGNALED(status)) signal = WTERMSIG(status);
+	else if (!WIFEXITED(status) || !WEXITSTATUS(status)) return FAILURE_NONE;
+	else if (WEXITSTATUS(status) == EXIT_TEMPORARY) return FAILURE_TRANSIENT;
+	else if (WEXITSTATUS(status) > 128) signal = WEXITSTATUS(status) - 128;
+	else return FAILURE_STATUS;
+	switch (signal)
+	{
+		case SIGKILL:
+		case SIGTERM:
+		case SIGHUP:
+		case SIGINT:
+		case SIGXFSZ:
+			return FAILURE_TRANSIENT;
 	}
+	return FAILURE_SIGNAL;
+}
+
+/**
+ * \fn int calibrate_inputs(Calibrate *calibrate, unsigned int simulation, \
+ *   unsigned int experiment, char input[4][32])
+ * \brief Function to write the simulator input files of an experiment.
+ * \param calibrate
+ * \brief Calibration data.
+ * \param simulation
+ * \brief Simulation number.
+ * \param experiment
+ * \brief Experiment number.
+ * \param input
+ * \brief Array of input file names (empty if not used).
+ * \return 1 on success, 0 on error writing the files.
+ */
+int calibrate_inputs(Calibrate *calibrate, unsigned int simulation,
+	unsigned int experiment, char input[4][32])
+{
+	unsigned int i;
+	int ok;
+	for (i = 0, ok = 1; i < calibrate->ninputs; ++i)
+	{
+		snprintf(&input[i][0], 32, "input-%u-%u-%u", i, simulation, experiment);
 #if DEBUG
-printf("calibrate_sequential: end\n");
+printf("calibrate_inputs: i=%u input=%s\n", i, &input[i][0]);
 #endif
+		ok = calibrate_input(calibrate, simulation, &input[i][0],
+			calibrate->file[i][experiment]) && ok;
+	}
+	for (; i < 4; ++i) input[i][0] = 0;
+	return ok;
 }
 
 /**
- * \fn void calibrate_sweep(Calibrate *calibrate)
- * \brief Function to calibrate with the sweep algorithm.
+ * \fn double calibrate_evaluate(Calibrate *calibrate, \
+ *   unsigned int experiment, char *output, char *result, \
+ *   unsigned int *failure)
+ * \brief Function to calculate the objective function of an experiment.
  * \param calibrate
- * \brief Calibration data pointer.
+ * \brief Calibration data.
+ * \param experiment
+ * \brief Experiment number.
+ * \param output
+ * \brief Simulator output file name.
+ * \param result
+ * \brief Objective function file name.
+ * \return Objective function value.
+ * \param failure
+ * \brief Pointer to the failure class.
  */
-void calibrate_sweep(Calibrate *calibrate)
+double calibrate_evaluate(Calibrate *calibrate, unsigned int experiment,
+	char *output, char *result, unsigned int *failure)
 {
-	unsigned int i, j, k, l;
 	double e;
-	GThread *thread[calibrate->nthreads];
-	ParallelData data[calibrate->nthreads];
+	char buffer[512], *c;
+	FILE *file_result;
+	snprintf(buffer, 512, "./%s %s %s %s", calibrate->evaluator, output,
+		calibrate->experiment[experiment], result);
 #if DEBUG
-printf("calibrate_sweep: start\n");
+printf("calibrate_evaluate: %s\n", buffer);
 #endif
-	for (i = 0; i < calibrate->nsimulations; ++i)
+	*failure = calibrate_failure(system(buffer));
+	if (*failure) return calibrate->penalty;
+
+	// Reading the objective function value, failing on a missing, empty or
+	// not numeric result
+	e = NAN;
+	file_result = fopen(result, "r");
+	if (file_result)
 	{
-		k = i;
-		for (j = 0; j < calibrate->nvariables; ++j)
+		if (fgets(buffer, 512, file_result))
 		{
-			l = k % calibrate->nsweeps[j];
-			k /= calibrate->nsweeps[j];
-			e = calibrate->rangemin[j];
-			if (calibrate->nsweeps[j] > 1)
-				e += l * (calibrate->rangemax[j] - calibrate->rangemin[j])
-					/ (calibrate->nsweeps[j] - 1);
-			calibrate->value[i * calibrate->nvariables + j] = e;
+			e = strtod(buffer, &c);
+			if (c == buffer) e = NAN;
 		}
+		fclose(file_result);
 	}
-	if (calibrate->nthreads <= 1)
-		calibrate_sequential(calibrate);
-	else
+	if (!isfinite(e))
 	{
-		for (i = 0; i < calibrate->nthreads; ++i)
-		{
-			data[i].calibrate = calibrate;
-			data[i].thread = i;
-			thread[i] = g_thread_new(NULL, (void(*))calibrate_thread, &data[i]);
-		}
-		for (i = 0; i < calibrate->nthreads; ++i) g_thread_join(thread[i]);
+		*failure = FAILURE_RESULT;
+		e = calibrate->penalty;
 	}
+	return e;
+}
+
+/**
+ * \fn double calibrate_parse(Calibrate *calibrate, unsigned int simulation, \
+ *   unsigned int experiment, unsigned int *failure)
+ * \brief Function to parse input files, simulating and calculating the \
+ *   objective function.
+ * \param calibrate
+ * \brief Calibration data.
+ * \param simulation
+ * \brief Simulation number.
+ * \param experiment
+ * \brief Experiment number.
+ * \param failure
+ * \brief Pointer to the failure class.
+ * \return Objective function value (the penalty on failures).
+ */
+double calibrate_parse(Calibrate *calibrate, unsigned int simulation,
+	unsigned int experiment, unsigned int *failure)
+{
+	double e;
+	char buffer[512], input[4][32], output[32], result[32];
+
 #if DEBUG
-printf("calibrate_sweep: end\n");
+printf("calibrate_parse: start\n");
+printf("calibrate_parse: simulation=%u experiment=%u\n", simulation,
+experiment);
+#endif
+
+	// Opening input files
+	*failure = FAILURE_NONE;
+	if (!calibrate_inputs(calibrate, simulation, experiment, input))
+		*failure = FAILURE_TRANSIENT;
+#if DEBUG
+printf("calibrate_parse: parsing end\n");
+#endif
+
+	// Performing the simulation
+	snprintf(output, 32, "output-%u-%u", simulation, experiment);
+	snprintf(result, 32, "result-%u-%u", simulation, experiment);
+	snprintf(buffer, 512, "./%s %s %s %s %s %s", calibrate->simulator,
+		&input[0][0], &input[1][0], &input[2][0], &input[3][0], output);
+#if DEBUG
+printf("calibrate_parse: %s\n", buffer);
+#endif
+	if (!*failure)
+		*failure
+			= calibrate_failure(calibrate_simulate(calibrate, buffer, output));
+	if (!*failure && access(output, F_OK)) *failure = FAILURE_OUTPUT;
+
+	// Checking the objective value function
+	if (*failure) e = calibrate->penalty;
+	else e = calibrate_evaluate(calibrate, experiment, output, result, failure);
+
+	// Removing files
+#if !DEBUG
+	snprintf(buffer, 512, "rm -f %s %s %s %s %s %s", &input[0][0], &input[1][0],
+		&input[2][0], &input[3][0], output, result);
+	system(buffer);
+#endif
+
+#if DEBUG
+printf("calibrate_parse: end\n");
 #endif
+
+	// Returning the objective function
+	return e;
 }
 
 /**
- * \fn void calibrate_MonteCarlo(Calibrate *calibrate)
- * \brief Function to calibrate with the Monte-Carlo algorithm.
+ * \fn double calibrate_parse_multi(Calibrate *calibrate, \
+ *   unsigned int simulation, unsigned int *failure)
+ * \brief Function to parse input files of all experiments, simulating all of
+ *   them in a single simulator run and calculating the objective function.
  * \param calibrate
- * \brief Calibration data pointer.
+ * \brief Calibration data.
+ * \param simulation
+ * \brief Simulation number.
+ * \param failure
+ * \brief Array of failure classes of every experiment.
+ * \return Objective function value.
  */
-void calibrate_MonteCarlo(Calibrate *calibrate)
+double calibrate_parse_multi(Calibrate *calibrate, unsigned int simulation,
+	unsigned int *failure)
 {
-	unsigned int i, j;
-	GThread *thread[calibrate->nthreads];
-	ParallelData data[calibrate->nthreads];
+	unsigned int i, j, k, n;
+	double e;
+	char *buffer, input[calibrate->nexperiments][4][32], manifest[32],
+		output[calibrate->nexperiments][32], result[32];
+	FILE *file;
+
 #if DEBUG
-printf("calibrate_MonteCarlo: start\n");
+printf("calibrate_parse_multi: start\n");
+printf("calibrate_parse_multi: simulation=%u\n", simulation);
 #endif
-	for (i = 0; i < calibrate->nsimulations; ++i)
-		for (j = 0; j < calibrate->nvariables; ++j)
-			calibrate->value[i * calibrate->nvariables + j] =
-				calibrate->rangemin[j] + gsl_rng_uniform(rng)
-				* (calibrate->rangemax[j] - calibrate->rangemin[j]);
-	if (calibrate->nthreads <= 1)
-		calibrate_sequential(calibrate);
+
+	// Opening input files of all experiments
+	for (j = 0, k = FAILURE_NONE; j < calibrate->nexperiments; ++j)
+	{
+		if (!calibrate_inputs(calibrate, simulation, j, input[j]))
+			k = FAILURE_TRANSIENT;
+		snprintf(&output[j][0], 32, "output-%u-%u", simulation, j);
+	}
+
+	// Building the simulator command line
+	n = 64 + strlen(calibrate->simulator)
+		+ 32 * (calibrate->ninputs + 1) * calibrate->nexperiments;
+	buffer = (char*)malloc(n);
+	if (calibrate->multi_experiment == MULTI_EXPERIMENT_MANIFEST)
+	{
+		// A manifest line with the input and output files of every experiment
+		snprintf(manifest, 32, "manifest-%u", simulation);
+		file = fopen(manifest, "w");
+		if (!file) k = FAILURE_TRANSIENT;
+		else
+		{
+			for (j = 0; j < calibrate->nexperiments; ++j)
+			{
+				for (i = 0; i < calibrate->ninputs; ++i)
+					fprintf(file, "%s ", &input[j][i][0]);
+				fprintf(file, "%s\n", &output[j][0]);
+			}
+			if (fclose(file)) k = FAILURE_TRANSIENT;
+		}
+		snprintf(buffer, n, "./%s %s", calibrate->simulator, manifest);
+	}
 	else
 	{
-		for (i = 0; i < calibrate->nthreads; ++i)
+		// A group of input and output file arguments for every experiment
+		snprintf(buffer, n, "./%s", calibrate->simulator);
+		for (j = 0; j < calibrate->nexperiments; ++j)
 		{
-			data[i].calibrate = calibrate;
-			data[i].thread = i;
-			thread[i] = g_thread_new(NULL, (void(*))calibrate_thread, &data[i]);
+			for (i = 0; i < calibrate->ninputs; ++i)
+			{
+				strcat(buffer, " ");
+				strcat(buffer, &input[j][i][0]);
+			}
+			strcat(buffer, " ");
+			strcat(buffer, &output[j][0]);
 		}
-		for (i = 0; i < calibrate->nthreads; ++i) g_thread_join(thread[i]);
 	}
+
+	// Performing the simulation of all experiments
 #if DEBUG
-printf("calibrate_MonteCarlo: end\n");
+printf("calibrate_parse_multi: %s\n", buffer);
+#endif
+	if (!k)
+		k = calibrate_failure(calibrate_simulate(calibrate, buffer,
+			&output[0][0]));
+
+	// Checking the objective value function of every experiment
+	for (j = 0, e = 0.; j < calibrate->nexperiments; ++j)
+	{
+		snprintf(result, 32, "result-%u-%u", simulation, j);
+		failure[j] = k;
+		if (!failure[j] && access(&output[j][0], F_OK))
+			failure[j] = FAILURE_OUTPUT;
+		if (failure[j]) e += calibrate->penalty;
+		else
+			e += calibrate_evaluate(calibrate, j, &output[j][0], result,
+				failure + j);
+
+		// Removing files
+#if !DEBUG
+		snprintf(buffer, n, "rm -f %s %s %s %s %s %s", &input[j][0][0],
+			&input[j][1][0], &input[j][2][0], &input[j][3][0], &output[j][0],
+			result);
+		system(buffer);
+#endif
+	}
+#if !DEBUG
+	if (calibrate->multi_experiment == MULTI_EXPERIMENT_MANIFEST)
+		remove(manifest);
+#endif
+	free(buffer);
+
+#if DEBUG
+printf("calibrate_parse_multi: end\n");
 #endif
+
+	// Returning the objective function
+	return e;
 }
 
 /**
- * \fn void calibrate_genetic(Calibrate *calibrate)
- * \brief Function to calibrate with the Monte-Carlo algorithm.
+ * \fn int calibrate_best_worse(Calibrate *calibrate, unsigned int a, \
+ *   unsigned int b)
+ * \brief Function to compare two saved best simulations by objective function
+ *   value and simulation number.
  * \param calibrate
- * \brief Calibration data pointer.
+ * \brief Calibration data.
+ * \param a
+ * \brief Slot of the first saved simulation.
+ * \param b
+ * \brief Slot of the second saved simulation.
+ * \return 1 if the first simulation is worse, 0 otherwise.
  */
-void calibrate_genetic(Calibrate *calibrate)
+int calibrate_best_worse(Calibrate *calibrate, unsigned int a, unsigned int b)
 {
+	if (calibrate->error_best[a] != calibrate->error_best[b])
+		return calibrate->error_best[a] > calibrate->error_best[b];
+	return calibrate->simulation_best[a] > calibrate->simulation_best[b];
 }
 
-void calibrate_merge(Calibrate *calibrate, unsigned int nsaveds,
-	unsigned int *simulation_best, double *error_best)
+/**
+ * \fn void calibrate_best_down(Calibrate *calibrate, unsigned int i, \
+ *   unsigned int n)
+ * \brief Function to move down a slot in the heap of the bests until its
+ *   children are better.
+ * \param calibrate
+ * \brief Calibration data.
+ * \param i
+ * \brief Heap position of the slot.
+ * \param n
+ * \brief Heap size.
+ */
+void calibrate_best_down(Calibrate *calibrate, unsigned int i, unsigned int n)
 {
-	unsigned int i, j, k, s[calibrate->nbests];
-	double e[calibrate->nbests];
-	i = j = k = 0;
-	do
+	unsigned int j, k, *heap;
+	heap = calibrate->heap;
+	for (; (j = 2 * i + 1) < n; i = j)
 	{
-		if (i > calibrate->nsaveds
-			|| calibrate->error_best[i] > error_best[j])
-		{
-			s[k] = simulation_best[j];
-			e[k] = error_best[j];
+		if (j + 1 < n && calibrate_best_worse(calibrate, heap[j + 1], heap[j]))
 			++j;
-		}
-		else
-		{
-			s[k] = calibrate->simulation_best[i];
-			e[k] = calibrate->error_best[i];
-			++i;
-		}
-		++k;
+		if (!calibrate_best_worse(calibrate, heap[j], heap[i])) break;
+		k = heap[i];
+		heap[i] = heap[j];
+		heap[j] = k;
+	}
+}
+
+/**
+ * \fn void calibrate_best_insert(Calibrate *calibrate, \
+ *   unsigned int simulation, double value, double *variable)
+ * \brief Function to save a simulation in the bests. The bests are saved in
+ *   slots, unsorted, and a binary heap of the slots keeps the worst saved
+ *   simulation on the top to be replaced. On threads, the mutex has to be
+ *   locked.
+ * \param calibrate
+ * \brief Calibration data.
+ * \param simulation
+ * \brief Simulation number.
+ * \param value
+ * \brief Objective function value.
+ * \param variable
+ * \brief Array of variable values.
+ */
+void calibrate_best_insert(Calibrate *calibrate, unsigned int simulation,
+	double value, double *variable)
+{
+	unsigned int i, j, k, *heap;
+#if DEBUG
+printf("calibrate_best_insert: start\n");
+#endif
+	heap = calibrate->heap;
+
+	// Replacing the worst saved simulation if the bests are full
+	if (calibrate->nsaveds == calibrate->nbests)
+	{
+		k = heap[0];
+		if (!(value < calibrate->error_best[k]
+			|| (value == calibrate->error_best[k]
+			&& simulation < calibrate->simulation_best[k])))
+			return;
+		i = 0;
+	}
+	else
+	{
+		i = k = calibrate->nsaveds++;
+		heap[i] = k;
 	}
-	while (k < calibrate->nbests && (i < calibrate->nsaveds || j < nsaveds));
-	calibrate->nsaveds = k;
-	for (i = 0; i < k; ++i)
+	calibrate->error_best[k] = value;
+	calibrate->simulation_best[k] = simulation;
+	memcpy(calibrate->value_best + k * calibrate->nvariables, variable,
+		calibrate->nvariables * sizeof(double));
+	calibrate->sorted = 0;
+
+	// Restoring the heap
+	if (!i) calibrate_best_down(calibrate, 0, calibrate->nsaveds);
+	else for (; i; i = j)
 	{
-		calibrate->simulation_best[i] = s[i];
-		calibrate->error_best[i] = e[i];
+		j = (i - 1) / 2;
+		if (!calibrate_best_worse(calibrate, k, heap[j])) break;
+		heap[i] = heap[j];
+		heap[j] = k;
 	}
+#if DEBUG
+printf("calibrate_best_insert: end\n");
+#endif
 }
 
 /**
- * \fn int calibrate_new(Calibrate *calibrate, char *filename)
- * \brief Function to open and perform a calibration.
+ * \fn void calibrate_best(Calibrate *calibrate, unsigned int simulation, \
+ *   double value)
+ * \brief Function to save the bests simulations. On threads, the mutex has to
+ *   be locked.
  * \param calibrate
- * \brief Calibration data pointer.
- * \param filename
- * \brief Input data file name.
- * \return 1 on success, 0 on error.
+ * \brief Calibration data.
+ * \param simulation
+ * \brief Simulation number.
+ * \param value
+ * \brief Objective function value.
  */
-int calibrate_new(Calibrate *calibrate, char *filename)
+void calibrate_best(Calibrate *calibrate, unsigned int simulation,
+	double value)
 {
-	unsigned int i, j;
-	char buffer2[512];
-	xmlChar *buffer;
-	xmlNode *node, *child;
-	xmlDoc *doc;
-#if HAVE_MPI
-	unsigned int nsaveds, *simulation_best;
-	double *error_best;
-	MPI_Status mpi_stat;
+	calibrate_best_insert(calibrate, simulation, value,
+		calibrate->value + simulation * calibrate->nvariables);
+}
+
+/**
+ * \fn void calibrate_best_sort(Calibrate *calibrate)
+ * \brief Function to sort the bests by objective function value and
+ *   simulation number, only when they are read in order.
+ * \param calibrate
+ * \brief Calibration data.
+ */
+void calibrate_best_sort(Calibrate *calibrate)
+{
+	unsigned int i, j, k, n, s, *heap;
+	double e, v[calibrate->nvariables];
+#if DEBUG
+printf("calibrate_best_sort: start\n");
 #endif
-	static const xmlChar *template[4]=
-		{XML_TEMPLATE1, XML_TEMPLATE2, XML_TEMPLATE3, XML_TEMPLATE4};
+	if (calibrate->sorted) return;
+	heap = calibrate->heap;
+	n = calibrate->nsaveds;
+
+	// Heap sort of the slots, moving the worst to the end
+	for (i = n; i > 1;)
+	{
+		--i;
+		k = heap[0];
+		heap[0] = heap[i];
+		heap[i] = k;
+		calibrate_best_down(calibrate, 0, i);
+	}
+
+	// Moving the saved simulations to the sorted slots, following the cycles
+	// of the permutation
+	for (i = 0; i < n; ++i)
+	{
+		if (heap[i] == i) continue;
+		e = calibrate->error_best[i];
+		s = calibrate->simulation_best[i];
+		memcpy(v, calibrate->value_best + i * calibrate->nvariables,
+			calibrate->nvariables * sizeof(double));
+		for (j = i; heap[j] != i; j = k)
+		{
+			k = heap[j];
+			calibrate->error_best[j] = calibrate->error_best[k];
+			calibrate->simulation_best[j] = calibrate->simulation_best[k];
+			memcpy(calibrate->value_best + j * calibrate->nvariables,
+				calibrate->value_best + k * calibrate->nvariables,
+				calibrate->nvariables * sizeof(double));
+			heap[j] = j;
+		}
+		calibrate->error_best[j] = e;
+		calibrate->simulation_best[j] = s;
+		memcpy(calibrate->value_best + j * calibrate->nvariables, v,
+			calibrate->nvariables * sizeof(double));
+		heap[j] = j;
+	}
 
+	// The sorted slots in reverse order are a heap
+	for (i = 0; i < n; ++i) heap[i] = n - 1 - i;
+	calibrate->sorted = 1;
 #if DEBUG
-printf("calibrate_new: start\n");
+printf("calibrate_best_sort: end\n");
 #endif
+}
+
+/**
+ * \fn void calibrate_key(Calibrate *calibrate, unsigned int simulation, \
+ *   char *key)
+ * \brief Function to get the key of the variable values of a simulation: the
+ *   variable values written with the c-string formats passed to the simulator,
+ *   truncated as on the templates, so different keys are different inputs.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param simulation
+ * \brief Simulation number.
+ * \param key
+ * \brief Key string, with a size of nvariables * VALUE_LENGTH + 1 characters.
+ */
+void calibrate_key(Calibrate *calibrate, unsigned int simulation, char *key)
+{
+	unsigned int j, k;
+	for (j = k = 0; j < calibrate->nvariables; ++j)
+	{
+		snprintf(key + k, VALUE_LENGTH, calibrate->format[j],
+			calibrate->value[simulation * calibrate->nvariables + j]);
+		k += strlen(key + k);
+		key[k++] = ' ';
+	}
+	key[k] = 0;
+}
+
+/**
+ * \fn int calibrate_stored(Calibrate *calibrate, unsigned int experiment, \
+ *   char *key, double *e)
+ * \brief Function to look for the stored objective function value of an
+ *   experiment.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param experiment
+ * \brief Experiment number.
+ * \param key
+ * \brief Key of the variable values.
+ * \param e
+ * \brief Pointer to the objective function value.
+ * \return 1 if the value is stored, 0 otherwise.
+ */
+int calibrate_stored(Calibrate *calibrate, unsigned int experiment, char *key,
+	double *e)
+{
+	double *stored;
+	char buffer[calibrate->nvariables * VALUE_LENGTH + 81];
+	snprintf(buffer, calibrate->nvariables * VALUE_LENGTH + 81, "%s %s",
+		calibrate->hash[experiment], key);
+	g_mutex_lock(&mutex);
+	stored = (double*)g_hash_table_lookup(calibrate->stored, buffer);
+	if (stored)
+	{
+		*e = *stored;
+		++calibrate->nreused;
+	}
+	g_mutex_unlock(&mutex);
+	return stored != NULL;
+}
+
+/**
+ * \fn void calibrate_store(Calibrate *calibrate, unsigned int experiment, \
+ *   char *key, double e)
+ * \brief Function to store the objective function value of an experiment.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param experiment
+ * \brief Experiment number.
+ * \param key
+ * \brief Key of the variable values.
+ * \param e
+ * \brief Objective function value.
+ */
+void calibrate_store(Calibrate *calibrate, unsigned int experiment, char *key,
+	double e)
+{
+	double *stored;
+	stored = g_new(double, 1);
+	*stored = e;
+	g_mutex_lock(&mutex);
+	g_hash_table_insert(calibrate->stored,
+		g_strdup_printf("%s %s", calibrate->hash[experiment], key), stored);
+	fprintf(calibrate->file_store, "%s %.17le %s\n",
+		calibrate->hash[experiment], e, key);
+	fflush(calibrate->file_store);
+	++calibrate->nstored;
+	g_mutex_unlock(&mutex);
+}
+
+/**
+ * \fn double calibrate_objective(Calibrate *calibrate, \
+ *   unsigned int simulation, unsigned int *failure)
+ * \brief Function to calculate the objective function of a simulation adding
+ *   the objective function values of all experiments. With a store, the
+ *   stored experiments are not simulated. The failed experiments add the
+ *   penalty.
+ * \param calibrate
+ * \brief Calibration data.
+ * \param simulation
+ * \brief Simulation number.
+ * \param failure
+ * \brief Pointer to the failure class of the simulation (transient if an
+ *   experiment has a transient failure, else the first failure class).
+ * \return Objective function value.
+ */
+double calibrate_objective(Calibrate *calibrate, unsigned int simulation,
+	unsigned int *failure)
+{
+	unsigned int j, nfailures, failures[calibrate->nexperiments];
+	double e, ej;
+	char key[calibrate->nvariables * VALUE_LENGTH + 1];
+	if (calibrate->multi_experiment)
+		e = calibrate_parse_multi(calibrate, simulation, failures);
+	else
+	{
+		if (calibrate->store) calibrate_key(calibrate, simulation, key);
+		e = 0.;
+		for (j = 0; j < calibrate->nexperiments; ++j)
+		{
+			failures[j] = FAILURE_NONE;
+			if (!calibrate->store || !calibrate_stored(calibrate, j, key, &ej))
+			{
+				ej = calibrate_parse(calibrate, simulation, j, failures + j);
+				if (calibrate->store && failures[j] != FAILURE_TRANSIENT)
+					calibrate_store(calibrate, j, key, ej);
+			}
+			e += ej;
+		}
+	}
+
+	// Counting the failures
+	*failure = FAILURE_NONE;
+	for (j = nfailures = 0; j < calibrate->nexperiments; ++j)
+		if (failures[j])
+		{
+			++nfailures;
+			if (!*failure || failures[j] == FAILURE_TRANSIENT)
+				*failure = failures[j];
+		}
+	if (nfailures)
+	{
+		g_mutex_lock(&mutex);
+		for (j = 0; j < calibrate->nexperiments; ++j)
+			++calibrate->nfailures[failures[j]];
+		g_mutex_unlock(&mutex);
+	}
+	return e;
+}
+
+/**
+ * \fn double calibrate_improvement(Calibrate *calibrate, \
+ *   unsigned int nsimulations)
+ * \brief Function to estimate the probability that a number of new
+ *   simulations improve the best objective function value by more than the
+ *   tolerance. The lower tail of the objective function, below the worst
+ *   saved best, is fitted to a generalized Pareto distribution by probability
+ *   weighted moments.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param nsimulations
+ * \brief Number of new simulations.
+ * \return Probability of improvement.
+ */
+double calibrate_improvement(Calibrate *calibrate, unsigned int nsimulations)
+{
+	unsigned int i, m;
+	double a0, a1, u, y, sigma, xi, p;
+
+	// Exceedances over the threshold, sorted in increasing order
+	calibrate_best_sort(calibrate);
+	m = calibrate->nsaveds - 1;
+	u = calibrate->error_best[m];
+	for (i = 0, a0 = a1 = 0.; i < m; ++i)
+	{
+		y = u - calibrate->error_best[m - 1 - i];
+		a0 += y;
+		a1 += (m - 1 - i) * y;
+	}
+	a0 /= m;
+	a1 /= m * (m - 1.);
+	if (a0 <= 0.) return 0.;
+
+	// Generalized Pareto parameters
+	y = a0 - 2. * a1;
+	if (y <= 0.) return 1.;
+	sigma = 2. * a0 * a1 / y;
+	xi = 2. - a0 / y;
+
+	// Probability that a simulation improves the best more than tolerance
+	y = u - calibrate->error_best[0] + calibrate->tolerance;
+	if (fabs(xi) < 1.e-6) p = exp(-y / sigma);
+	else
+	{
+		p = 1. + xi * y / sigma;
+		p = (p <= 0.) ? 0. : pow(p, -1. / xi);
+	}
+	p *= (double)m / calibrate->nevaluated;
+
+	// Probability for the new simulations
+	if (p >= 1.) return 1.;
+	return -expm1(nsimulations * log1p(-p));
+}
+
+/**
+ * \fn void calibrate_observe(Calibrate *calibrate, unsigned int simulation, \
+ *   unsigned int failed)
+ * \brief Function to add a performed simulation to the failure classifier.
+ *   Up to FAILURE_OBSERVATIONS simulations are kept, as a uniform random
+ *   sample of the observed ones, to bound the cost of the predictions. On
+ *   threads, the mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param simulation
+ * \brief Simulation number.
+ * \param failed
+ * \brief 1 if the simulation failed, 0 otherwise.
+ */
+void calibrate_observe(Calibrate *calibrate, unsigned int simulation,
+	unsigned int failed)
+{
+	unsigned int j, n;
+	double w, *x;
+	n = calibrate->nobservations;
+	++calibrate->nobserved;
+
+	// Replacing a random kept simulation when full (reservoir sampling)
+	if (n == FAILURE_OBSERVATIONS)
+	{
+		n = gsl_rng_uniform_int(calibrate->rng_failure, calibrate->nobserved);
+		if (n >= FAILURE_OBSERVATIONS) return;
+		calibrate->nfailed -= calibrate->failed[n];
+		--calibrate->nobservations;
+	}
+
+	// Doubling the arrays size when full
+	else if (!(n & (n - 1)))
+	{
+		calibrate->observation = (double*)realloc(calibrate->observation,
+			(n ? 2 * n : 1) * calibrate->nvariables * sizeof(double));
+		calibrate->failed = (unsigned int*)realloc(calibrate->failed,
+			(n ? 2 * n : 1) * sizeof(unsigned int));
+	}
+
+	// Normalizing the variable values on the ranges
+	x = calibrate->observation + n * calibrate->nvariables;
+	for (j = 0; j < calibrate->nvariables; ++j)
+	{
+		w = calibrate->rangemax[j] - calibrate->rangemin[j];
+		x[j] = (w > 0.)
+			? (calibrate->value[simulation * calibrate->nvariables + j]
+			- calibrate->rangemin[j]) / w: 0.;
+	}
+	calibrate->failed[n] = failed;
+	calibrate->nfailed += failed;
+	++calibrate->nobservations;
+}
+
+/**
+ * \fn double calibrate_failure_probability(Calibrate *calibrate, \
+ *   unsigned int simulation)
+ * \brief Function to predict the failure probability of a simulation as the
+ *   fraction of failed simulations between the nearest observed simulations
+ *   on the normalized variables. On threads, the mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param simulation
+ * \brief Simulation number.
+ * \return Predicted failure probability.
+ */
+double calibrate_failure_probability(Calibrate *calibrate,
+	unsigned int simulation)
+{
+	unsigned int i, j, k, n, failed[FAILURE_NEIGHBOURS];
+	double d, w, x, distance[FAILURE_NEIGHBOURS], *value, *observation;
+	if (!calibrate->nfailed || calibrate->nobservations < FAILURE_NEIGHBOURS)
+		return 0.;
+	value = calibrate->value + simulation * calibrate->nvariables;
+	for (i = n = 0; i < calibrate->nobservations; ++i)
+	{
+		observation = calibrate->observation + i * calibrate->nvariables;
+		for (j = 0, d = 0.; j < calibrate->nvariables; ++j)
+		{
+			w = calibrate->rangemax[j] - calibrate->rangemin[j];
+			x = (w > 0.)? (value[j] - calibrate->rangemin[j]) / w: 0.;
+			x -= observation[j];
+			d += x * x;
+		}
+
+		// Inserting the observation on the sorted nearest ones
+		if (n < FAILURE_NEIGHBOURS) ++n;
+		else if (d >= distance[n - 1]) continue;
+		for (k = n - 1; k && d < distance[k - 1]; --k)
+		{
+			distance[k] = distance[k - 1];
+			failed[k] = failed[k - 1];
+		}
+		distance[k] = d;
+		failed[k] = calibrate->failed[i];
+	}
+	for (i = k = 0; i < n; ++i) k += failed[i];
+	return ((double)k) / n;
+}
+
+/**
+ * \fn int calibrate_screen(Calibrate *calibrate, unsigned int simulation)
+ * \brief Function to check if a new simulation has to be skipped because the
+ *   failure classifier predicts a failure. A fraction of the predicted
+ *   failures is performed to refine the classifier. On threads, the mutex has
+ *   to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param simulation
+ * \brief Simulation number.
+ * \return 1 if the simulation is skipped, 0 otherwise.
+ */
+int calibrate_screen(Calibrate *calibrate, unsigned int simulation)
+{
+	if (calibrate->failure_threshold >= 1.
+		|| calibrate_failure_probability(calibrate, simulation)
+		<= calibrate->failure_threshold
+		|| gsl_rng_uniform(calibrate->rng_failure) < calibrate->failure_explore)
+		return 0;
+	++calibrate->nscreened;
+#if DEBUG
+printf("calibrate_screen: simulation=%u skipped\n", simulation);
+#endif
+	return 1;
+}
+
+/**
+ * \fn int calibrate_inside(Calibrate *calibrate, unsigned int simulation, \
+ *   double *minimum, double *maximum)
+ * \brief Function to check if the variable values of a simulation are inside
+ *   a region.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param simulation
+ * \brief Simulation number.
+ * \param minimum
+ * \brief Array of minimum variable values of the region.
+ * \param maximum
+ * \brief Array of maximum variable values of the region.
+ * \return 1 if the simulation is inside the region, 0 otherwise.
+ */
+int calibrate_inside(Calibrate *calibrate, unsigned int simulation,
+	double *minimum, double *maximum)
+{
+	unsigned int j;
+	double *value;
+	value = calibrate->value + simulation * calibrate->nvariables;
+	for (j = 0; j < calibrate->nvariables; ++j)
+		if (value[j] < minimum[j] || value[j] > maximum[j]) return 0;
+	return 1;
+}
+
+/**
+ * \fn int calibrate_owned(Calibrate *calibrate, unsigned int simulation)
+ * \brief Function to check if a simulation of the task is on the shard of the
+ *   process and it is not dispatched.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param simulation
+ * \brief Simulation number.
+ * \return 1 if the simulation can be dispatched, 0 otherwise.
+ */
+int calibrate_owned(Calibrate *calibrate, unsigned int simulation)
+{
+	if (calibrate->shard_mode == SHARD_MODE_INTERLEAVED
+		&& simulation % calibrate->nshards != calibrate->shard)
+		return 0;
+	return !calibrate->taken
+		|| !calibrate->taken[simulation - calibrate->nstart];
+}
+
+/**
+ * \fn int calibrate_cancel(Calibrate *calibrate, unsigned int simulation)
+ * \brief Function to cancel a simulation out of the steered bounds. On
+ *   threads, the mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param simulation
+ * \brief Simulation number.
+ * \return 1 if the simulation is cancelled, 0 otherwise.
+ */
+int calibrate_cancel(Calibrate *calibrate, unsigned int simulation)
+{
+	if (!calibrate->control || calibrate_inside(calibrate, simulation,
+		calibrate->bound_min, calibrate->bound_max))
+		return 0;
+	++calibrate->ncancelled;
+#if DEBUG
+printf("calibrate_cancel: simulation=%u cancelled\n", simulation);
+#endif
+	return 1;
+}
+
+/**
+ * \fn unsigned int calibrate_label(Calibrate *calibrate, char *label)
+ * \brief Function to get the number of a variable from its label.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param label
+ * \brief Variable label.
+ * \return Variable number, the number of variables if not found.
+ */
+unsigned int calibrate_label(Calibrate *calibrate, char *label)
+{
+	unsigned int j;
+	for (j = 0; j < calibrate->nvariables; ++j)
+		if (!strcmp(calibrate->label[j], label)) break;
+	return j;
+}
+
+/**
+ * \fn void calibrate_log(Calibrate *calibrate, char *command)
+ * \brief Function to log a steering command with the batch and the next
+ *   simulation where it is applied, on the results output and on the steering
+ *   log. On threads, the mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param command
+ * \brief Steering command.
+ */
+void calibrate_log(Calibrate *calibrate, char *command)
+{
+	if (!calibrate->file_control) return;
+	printf("# steer: batch=%u simulation=%u %s\n", calibrate->nbatches,
+		calibrate->nnext, command);
+	fflush(stdout);
+	fprintf(calibrate->file_control, "# steer: batch=%u simulation=%u %s\n",
+		calibrate->nbatches, calibrate->nnext, command);
+	fflush(calibrate->file_control);
+}
+
+/**
+ * \fn int calibrate_batches(Calibrate *calibrate)
+ * \brief Function to check if the algorithm performs the simulations in
+ *   several batches.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \return 1 if the algorithm has several batches, 0 otherwise.
+ */
+int calibrate_batches(Calibrate *calibrate)
+{
+	return !calibrate->budget
+		&& calibrate->algorithm != CALIBRATE_ALGORITHM_MONTE_CARLO
+		&& calibrate->algorithm != CALIBRATE_ALGORITHM_SWEEP;
+}
+
+/**
+ * \fn void calibrate_steer(Calibrate *calibrate)
+ * \brief Function to apply the queued steering commands changing the variable
+ *   bounds or the priority region. On threads, the mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_steer(Calibrate *calibrate)
+{
+	unsigned int j;
+	double minimum, maximum;
+	char label[256], *c, *c2;
+	if (!calibrate->command) return;
+	for (c = calibrate->command; (c2 = strchr(c, '\n')); c = c2 + 1)
+	{
+		*c2 = 0;
+		if (!strcmp(c, "priority clear"))
+		{
+			for (j = 0; j < calibrate->nvariables; ++j)
+			{
+				calibrate->priority_min[j] = -INFINITY;
+				calibrate->priority_max[j] = INFINITY;
+			}
+			calibrate->npriority = 0;
+		}
+		else if (sscanf(c, "bounds %255s %lf %lf", label, &minimum, &maximum)
+			== 3)
+		{
+			j = calibrate_label(calibrate, label);
+			calibrate->rangemin[j] = calibrate->bound_min[j] = minimum;
+			calibrate->rangemax[j] = calibrate->bound_max[j] = maximum;
+		}
+		else if (sscanf(c, "priority %255s %lf %lf", label, &minimum, &maximum)
+			== 3)
+		{
+			j = calibrate_label(calibrate, label);
+			if (isinf(calibrate->priority_min[j])
+				&& isinf(calibrate->priority_max[j]))
+				++calibrate->npriority;
+			calibrate->priority_min[j] = minimum;
+			calibrate->priority_max[j] = maximum;
+		}
+		calibrate_log(calibrate, c);
+	}
+	free(calibrate->command);
+	calibrate->command = NULL;
+}
+
+/**
+ * \fn int calibrate_command(Calibrate *calibrate, char *command)
+ * \brief Function to perform a steering command. The dispatch commands are
+ *   performed at once and the bounds and priority commands are queued. With
+ *   several MPI tasks, the queued commands and the stop command are applied
+ *   between batches, so they are rejected on algorithms with only one batch.
+ *   The mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param command
+ * \brief Steering command.
+ * \return 1 on success, 0 on error.
+ */
+int calibrate_command(Calibrate *calibrate, char *command)
+{
+	unsigned int n;
+	double minimum, maximum;
+	char label[256];
+#ifdef HAVE_MPI
+	if (calibrate->mpi_tasks > 1 && !calibrate_batches(calibrate)
+		&& (!strcmp(command, "stop") || !strncmp(command, "bounds ", 7)
+		|| !strncmp(command, "priority ", 9)))
+		return 0;
+#endif
+	if (!strcmp(command, "pause")) calibrate->paused = 1;
+	else if (!strcmp(command, "resume")) calibrate->paused = 0;
+	else if (!strcmp(command, "stop")) calibrate->halt = 1;
+	else if (sscanf(command, "threads %u", &n) == 1)
+	{
+		if (!n || n > calibrate->nthreads) return 0;
+		calibrate->nactive = n;
+	}
+	else if (!strcmp(command, "priority clear")
+		|| ((sscanf(command, "bounds %255s %lf %lf", label, &minimum, &maximum)
+		== 3 || sscanf(command, "priority %255s %lf %lf", label, &minimum,
+		&maximum) == 3) && calibrate_label(calibrate, label)
+		< calibrate->nvariables && minimum <= maximum))
+	{
+		// Queuing the command
+		n = calibrate->command ? strlen(calibrate->command) : 0;
+		calibrate->command = (char*)realloc(calibrate->command,
+			n + strlen(command) + 2);
+		sprintf(calibrate->command + n, "%s\n", command);
+		return 1;
+	}
+	else return 0;
+	calibrate_log(calibrate, command);
+	g_cond_broadcast(&cond);
+	return 1;
+}
+
+/**
+ * \fn void* calibrate_control(Calibrate *calibrate)
+ * \brief Function to read the steering commands from the control socket on a
+ *   thread. Every command line is answered with "ok" or "error".
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \return NULL
+ */
+void* calibrate_control(Calibrate *calibrate)
+{
+	struct pollfd descriptor;
+	int client;
+	unsigned int n, end;
+	ssize_t k;
+	char buffer[512], *c, *c2;
+#if DEBUG
+printf("calibrate_control: start\n");
+#endif
+	client = -1;
+	n = 0;
+	for (;;)
+	{
+		g_mutex_lock(&mutex);
+		end = calibrate->control_end;
+		g_mutex_unlock(&mutex);
+		if (end) break;
+
+		// Waiting a connection or a command
+		descriptor.fd = (client < 0) ? calibrate->control_socket : client;
+		descriptor.events = POLLIN;
+		if (poll(&descriptor, 1, CONTROL_INTERVAL) <= 0) continue;
+		if (client < 0)
+		{
+			client = accept(calibrate->control_socket, NULL, NULL);
+			n = 0;
+			continue;
+		}
+		k = read(client, buffer + n, 511 - n);
+		if (k <= 0)
+		{
+			close(client);
+			client = -1;
+			continue;
+		}
+		n += k;
+		buffer[n] = 0;
+
+		// Performing the complete command lines
+		for (c = buffer; (c2 = strchr(c, '\n')); c = c2 + 1)
+		{
+			*c2 = 0;
+			if (c2 > c && c2[-1] == '\r') c2[-1] = 0;
+			g_mutex_lock(&mutex);
+			k = calibrate_command(calibrate, c);
+			g_mutex_unlock(&mutex);
+			if (k) send(client, "ok\n", 3, MSG_NOSIGNAL);
+			else send(client, "error\n", 6, MSG_NOSIGNAL);
+		}
+		n -= c - buffer;
+		memmove(buffer, c, n);
+
+		// Discarding too long lines
+		if (n == 511) n = 0;
+	}
+	if (client >= 0) close(client);
+#if DEBUG
+printf("calibrate_control: end\n");
+#endif
+	return NULL;
+}
+
+/**
+ * \fn int calibrate_wait(Calibrate *calibrate, unsigned int thread)
+ * \brief Function to wait while the simulations dispatch is paused or the
+ *   thread is not active. The mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param thread
+ * \brief Thread number.
+ * \return 0 if the algorithm is stopped, 1 otherwise.
+ */
+int calibrate_wait(Calibrate *calibrate, unsigned int thread)
+{
+	while (!calibrate->halt
+		&& (calibrate->paused || thread >= calibrate->nactive)
+		&& (calibrate->nnext < calibrate->nend || calibrate->nretry))
+		g_cond_wait(&cond, &mutex);
+	return !calibrate->halt;
+}
+
+/**
+ * \fn int calibrate_next(Calibrate *calibrate, unsigned int *simulation, \
+ *   unsigned int thread)
+ * \brief Function to get the next simulation to perform on the task. The
+ *   simulations to retry are taken first, but not on the thread where they
+ *   failed while there are new simulations, and then the new simulations on
+ *   the priority region. The new simulations skipped by the failure classifier
+ *   get the penalty and the simulations out of the steered bounds are
+ *   cancelled. The mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param simulation
+ * \brief Pointer to the simulation number.
+ * \param thread
+ * \brief Thread number.
+ * \return 1 on success, 0 if there are no more simulations to perform.
+ */
+int calibrate_next(Calibrate *calibrate, unsigned int *simulation,
+	unsigned int thread)
+{
+	unsigned int i, j;
+	if (calibrate->control)
+	{
+		if (!calibrate_wait(calibrate, thread)) return 0;
+#ifdef HAVE_MPI
+		if (calibrate->mpi_tasks == 1)
+#endif
+		calibrate_steer(calibrate);
+	}
+	if (calibrate->stop) return 0;
+	for (;;)
+	{
+		while (calibrate->nnext < calibrate->nend
+			&& !calibrate_owned(calibrate, calibrate->nnext))
+			++calibrate->nnext;
+
+		// Simulations to retry
+		for (i = 0; i < calibrate->nretry; ++i)
+			if (calibrate->retry_thread[i] != thread
+				|| calibrate->nnext >= calibrate->nend)
+				break;
+		if (i < calibrate->nretry)
+		{
+			*simulation = calibrate->retry[i];
+			--calibrate->nretry;
+			memmove(calibrate->retry + i, calibrate->retry + i + 1,
+				(calibrate->nretry - i) * sizeof(unsigned int));
+			memmove(calibrate->retry_thread + i,
+				calibrate->retry_thread + i + 1,
+				(calibrate->nretry - i) * sizeof(unsigned int));
+			if (calibrate_cancel(calibrate, *simulation)) continue;
+			return 1;
+		}
+
+		// New simulations, first the ones on the priority region
+		if (calibrate->nnext >= calibrate->nend)
+		{
+			if (calibrate->control) g_cond_broadcast(&cond);
+			return 0;
+		}
+		j = calibrate->nnext;
+		if (calibrate->npriority)
+			for (i = j; i < calibrate->nend; ++i)
+				if (calibrate_owned(calibrate, i)
+					&& calibrate_inside(calibrate, i, calibrate->priority_min,
+					calibrate->priority_max))
+				{
+					j = i;
+					break;
+				}
+		if (calibrate->taken) calibrate->taken[j - calibrate->nstart] = 1;
+		if (j == calibrate->nnext) ++calibrate->nnext;
+		*simulation = j;
+		if (calibrate_cancel(calibrate, j)) continue;
+		if (!calibrate_screen(calibrate, j)) return 1;
+		calibrate->error[j] = calibrate->penalty * calibrate->nexperiments;
+		calibrate->screened[j] = 1;
+	}
+}
+
+/**
+ * \fn int calibrate_retry(Calibrate *calibrate, unsigned int simulation, \
+ *   unsigned int thread)
+ * \brief Function to queue a simulation with a transient failure to retry it
+ *   if it has retries left. On threads, the mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param simulation
+ * \brief Simulation number.
+ * \param thread
+ * \brief Thread number where the simulation failed.
+ * \return 1 if the simulation is queued, 0 if it has not retries left.
+ */
+int calibrate_retry(Calibrate *calibrate, unsigned int simulation,
+	unsigned int thread)
+{
+	if (calibrate->attempt[simulation - calibrate->nstart]
+		>= calibrate->retries)
+	{
+		++calibrate->nexhausted;
+		return 0;
+	}
+	++calibrate->attempt[simulation - calibrate->nstart];
+	++calibrate->nretried;
+	calibrate->retry[calibrate->nretry] = simulation;
+	calibrate->retry_thread[calibrate->nretry] = thread;
+	++calibrate->nretry;
+	return 1;
+}
+
+/**
+ * \fn void calibrate_check(Calibrate *calibrate)
+ * \brief Function to count a performed simulation and to check the stopping
+ *   rule. The rule sorts the bests, so it is checked every nbests/STOP_TAIL
+ *   performed simulations. On threads, the mutex has to be locked.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_check(Calibrate *calibrate)
+{
+	unsigned int n;
+	double p;
+	++calibrate->nevaluated;
+	if (calibrate->stop_probability <= 0. || calibrate->stop
+		|| calibrate->nsaveds < calibrate->nbests
+		|| calibrate->nevaluated < calibrate->nstop)
+		return;
+	calibrate->nstop = calibrate->nevaluated + calibrate->nbests / STOP_TAIL;
+	n = calibrate->nend - calibrate->nnext;
+	if (calibrate->shard_mode == SHARD_MODE_INTERLEAVED)
+		n /= calibrate->nshards;
+	p = calibrate_improvement(calibrate, n);
+#if DEBUG
+printf("calibrate_check: evaluated=%u probability=%lg\n",
+calibrate->nevaluated, p);
+#endif
+	if (p < calibrate->stop_probability) calibrate->stop = 1;
+}
+
+/**
+ * \fn void* calibrate_thread(ParallelData *data)
+ * \brief Function to calibrate on a thread.
+ * \param data
+ * \brief Function data.
+ * \return NULL
+ */
+void* calibrate_thread(ParallelData *data)
+{
+	unsigned int i, j, k;
+	double e;
+	Calibrate *calibrate;
+#if DEBUG
+printf("calibrate_thread: start\n");
+#endif
+	calibrate = data->calibrate;
+	for (;;)
+	{
+		g_mutex_lock(&mutex);
+		j = calibrate_next(calibrate, &i, data->thread);
+		g_mutex_unlock(&mutex);
+		if (!j) break;
+		e = calibrate_objective(calibrate, i, &j);
+		if (j == FAILURE_TRANSIENT)
+		{
+			g_mutex_lock(&mutex);
+			k = calibrate_retry(calibrate, i, data->thread);
+			g_mutex_unlock(&mutex);
+			if (k) continue;
+		}
+		if (calibrate->failure_threshold < 1.)
+		{
+			g_mutex_lock(&mutex);
+			calibrate->outcome[i - calibrate->nstart] = 1 + (j != FAILURE_NONE);
+			calibrate_observe(calibrate, i, j != FAILURE_NONE);
+			g_mutex_unlock(&mutex);
+		}
+		calibrate->error[i] = e;
+		g_mutex_lock(&mutex);
+		calibrate_best(calibrate, i, e);
+		calibrate_check(calibrate);
+		g_mutex_unlock(&mutex);
+#if DEBUG
+printf("calibrate_thread: thread=%u i=%u e=%lg\n", data->thread, i, e);
+#endif
+	}
+#if DEBUG
+printf("calibrate_thread: end\n");
+#endif
+	g_thread_exit(NULL);
+	return NULL;
+}
+
+/**
+ * \fn void calibrate_sequential(Calibrate *calibrate)
+ * \brief Function to calibrate sequentially.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_sequential(Calibrate *calibrate)
+{
+	unsigned int i, j;
+	double e;
+#if DEBUG
+printf("calibrate_sequential: start\n");
+#endif
+	for (;;)
+	{
+		g_mutex_lock(&mutex);
+		j = calibrate_next(calibrate, &i, 0);
+		g_mutex_unlock(&mutex);
+		if (!j) break;
+		e = calibrate_objective(calibrate, i, &j);
+		if (j == FAILURE_TRANSIENT && calibrate_retry(calibrate, i, 0))
+			continue;
+		if (calibrate->failure_threshold < 1.)
+		{
+			calibrate->outcome[i - calibrate->nstart] = 1 + (j != FAILURE_NONE);
+			calibrate_observe(calibrate, i, j != FAILURE_NONE);
+		}
+		calibrate->error[i] = e;
+		calibrate_best(calibrate, i, e);
+		calibrate_check(calibrate);
+#if DEBUG
+printf("calibrate_sequential: i=%u e=%lg\n", i, e);
+#endif
+	}
+#if DEBUG
+printf("calibrate_sequential: end\n");
+#endif
+}
+
+/**
+ * \fn void calibrate_run(Calibrate *calibrate, unsigned int first, \
+ *   unsigned int last)
+ * \brief Function to perform a range of simulations distributing them on the
+ *   tasks and the threads. At the end, every task has the objective function
+ *   values of all simulations of the range (NAN on not performed simulations).
+ *   With shards, only the simulations of the shard of the process are
+ *   performed.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param first
+ * \brief First simulation number.
+ * \param last
+ * \brief Last simulation number plus one.
+ */
+void calibrate_run(Calibrate *calibrate, unsigned int first, unsigned int last)
+{
+	unsigned int i;
+	GThread *thread[calibrate->nthreads];
+	ParallelData data[calibrate->nthreads];
+#ifdef HAVE_MPI
+	unsigned int *outcome;
+	int count[calibrate->mpi_tasks], displacement[calibrate->mpi_tasks];
+#endif
+#if DEBUG
+printf("calibrate_run: start\n");
+#endif
+	for (i = first; i < last; ++i)
+	{
+		calibrate->error[i] = NAN;
+		calibrate->screened[i] = 0;
+	}
+
+	// Calculating the simulations of a blocked shard
+	if (calibrate->shard_mode == SHARD_MODE_BLOCKED)
+	{
+		i = first;
+		first = i + calibrate->shard * (last - i) / calibrate->nshards;
+		last = i + (calibrate->shard + 1) * (last - i) / calibrate->nshards;
+	}
+
+	// Calculating simulations to perform on each task
+#ifdef HAVE_MPI
+	for (i = 0; i < calibrate->mpi_tasks; ++i)
+	{
+		displacement[i] = first + i * (last - first) / calibrate->mpi_tasks;
+		count[i] = first + (i + 1) * (last - first) / calibrate->mpi_tasks
+			- displacement[i];
+	}
+	calibrate->nstart = displacement[calibrate->mpi_rank];
+	calibrate->nend = calibrate->nstart + count[calibrate->mpi_rank];
+#else
+	calibrate->nstart = first;
+	calibrate->nend = last;
+#endif
+#if DEBUG
+printf("calibrate_run: nstart=%u nend=%u\n", calibrate->nstart,
+calibrate->nend);
+#endif
+
+	// Performing the simulations, the threads taking the next simulation to
+	// perform when they finish the previous one
+	i = calibrate->nend - calibrate->nstart;
+	calibrate->attempt = (unsigned int*)calloc(i + 1, sizeof(unsigned int));
+	calibrate->retry = (unsigned int*)malloc((i + 1) * sizeof(unsigned int));
+	calibrate->retry_thread
+		= (unsigned int*)malloc((i + 1) * sizeof(unsigned int));
+	calibrate->nretry = 0;
+	if (calibrate->failure_threshold < 1.)
+		calibrate->outcome = (unsigned int*)calloc(i + 1, sizeof(unsigned int));
+	if (calibrate->control)
+		calibrate->taken = (unsigned int*)calloc(i + 1, sizeof(unsigned int));
+	calibrate->nnext = calibrate->nstart;
+	calibrate->nevaluated = calibrate->stop = calibrate->nstop = 0;
+	if (calibrate->nthreads <= 1)
+		calibrate_sequential(calibrate);
+	else
+	{
+		for (i = 0; i < calibrate->nthreads; ++i)
+		{
+			data[i].calibrate = calibrate;
+			data[i].thread = i;
+			thread[i] = g_thread_new(NULL, (void(*))calibrate_thread, &data[i]);
+		}
+		for (i = 0; i < calibrate->nthreads; ++i) g_thread_join(thread[i]);
+	}
+	free(calibrate->retry_thread);
+	free(calibrate->retry);
+	free(calibrate->attempt);
+
+#ifdef HAVE_MPI
+	// Sharing the objective function values
+	MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, calibrate->error,
+		count, displacement, MPI_DOUBLE, calibrate->mpi_comm);
+
+	// Adding the simulations of the other tasks to the failure classifier
+	if (calibrate->failure_threshold < 1.)
+	{
+		outcome = (unsigned int*)malloc((last - first + 1)
+			* sizeof(unsigned int));
+		for (i = 0; i < calibrate->mpi_tasks; ++i) displacement[i] -= first;
+		MPI_Allgatherv(calibrate->outcome, count[calibrate->mpi_rank],
+			MPI_UNSIGNED, outcome, count, displacement, MPI_UNSIGNED,
+			calibrate->mpi_comm);
+		for (i = first; i < last; ++i)
+			if (i < calibrate->nstart || i >= calibrate->nend)
+			{
+				if (outcome[i - first])
+					calibrate_observe(calibrate, i, outcome[i - first] - 1);
+				else if (!isnan(calibrate->error[i]))
+					calibrate->screened[i] = 1;
+			}
+		free(outcome);
+	}
+#endif
+	if (calibrate->failure_threshold < 1.) free(calibrate->outcome);
+
+	// Applying the queued steering commands between batches, on all tasks
+	if (calibrate->control)
+	{
+		free(calibrate->taken);
+		calibrate->taken = NULL;
+		g_mutex_lock(&mutex);
+#ifdef HAVE_MPI
+		i = calibrate->command ? strlen(calibrate->command) + 1 : 0;
+		MPI_Bcast(&i, 1, MPI_UNSIGNED, 0, calibrate->mpi_comm);
+		MPI_Bcast(&calibrate->halt, 1, MPI_UNSIGNED, 0, calibrate->mpi_comm);
+		if (i)
+		{
+			if (calibrate->mpi_rank) calibrate->command = (char*)malloc(i);
+			MPI_Bcast(calibrate->command, i, MPI_CHAR, 0, calibrate->mpi_comm);
+		}
+#endif
+		calibrate_steer(calibrate);
+		g_mutex_unlock(&mutex);
+	}
+	++calibrate->nbatches;
+
+#if DEBUG
+printf("calibrate_run: end\n");
+#endif
+}
+
+/**
+ * \fn void calibrate_sweep(Calibrate *calibrate)
+ * \brief Function to calibrate with the sweep algorithm.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_sweep(Calibrate *calibrate)
+{
+	unsigned int i, j, k, l;
+	double e;
+#if DEBUG
+printf("calibrate_sweep: start\n");
+#endif
+	for (i = 0; i < calibrate->nsimulations; ++i)
+	{
+		k = i;
+		for (j = 0; j < calibrate->nvariables; ++j)
+		{
+			l = k % calibrate->nsweeps[j];
+			k /= calibrate->nsweeps[j];
+			e = calibrate->rangemin[j];
+			if (calibrate->nsweeps[j] > 1)
+				e += l * (calibrate->rangemax[j] - calibrate->rangemin[j])
+					/ (calibrate->nsweeps[j] - 1);
+			calibrate->value[i * calibrate->nvariables + j] = e;
+		}
+	}
+	calibrate_run(calibrate, 0, calibrate->nsimulations);
+#if DEBUG
+printf("calibrate_sweep: end\n");
+#endif
+}
+
+/**
+ * \fn void calibrate_MonteCarlo(Calibrate *calibrate)
+ * \brief Function to calibrate with the Monte-Carlo algorithm.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_MonteCarlo(Calibrate *calibrate)
+{
+	unsigned int i, j;
+#if DEBUG
+printf("calibrate_MonteCarlo: start\n");
+#endif
+	for (i = 0; i < calibrate->nsimulations; ++i)
+		for (j = 0; j < calibrate->nvariables; ++j)
+			calibrate->value[i * calibrate->nvariables + j] =
+				calibrate->rangemin[j] + gsl_rng_uniform(rng)
+				* (calibrate->rangemax[j] - calibrate->rangemin[j]);
+	calibrate_run(calibrate, 0, calibrate->nsimulations);
+#if DEBUG
+printf("calibrate_MonteCarlo: end\n");
+#endif
+}
+
+/**
+ * \fn void calibrate_genetic(Calibrate *calibrate)
+ * \brief Function to calibrate with the Monte-Carlo algorithm.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_genetic(Calibrate *calibrate)
+{
+}
+
+/**
+ * \fn double calibrate_autocorrelation(double *x, unsigned int n, \
+ *   unsigned int stride)
+ * \brief Function to estimate the integrated autocorrelation time of a series
+ *   with the automatic windowing of Sokal.
+ * \param x
+ * \brief Series.
+ * \param n
+ * \brief Series length.
+ * \param stride
+ * \brief Distance between consecutive elements of the series.
+ * \return Integrated autocorrelation time.
+ */
+double calibrate_autocorrelation(double *x, unsigned int n,
+	unsigned int stride)
+{
+	unsigned int i, k;
+	double mean, c0, c, tau;
+	for (i = 0, mean = 0.; i < n; ++i) mean += x[i * stride];
+	mean /= n;
+	for (i = 0, c0 = 0.; i < n; ++i)
+		c0 += (x[i * stride] - mean) * (x[i * stride] - mean);
+	if (c0 <= 0.) return 1.;
+	for (k = 1, tau = 1.; k < n; ++k)
+	{
+		for (i = 0, c = 0.; i + k < n; ++i)
+			c += (x[i * stride] - mean) * (x[(i + k) * stride] - mean);
+		tau += 2. * c / c0;
+		if (k >= MCMC_WINDOW * tau) break;
+	}
+	return tau;
+}
+
+/**
+ * \fn int calibrate_mcmc_stretch(Calibrate *calibrate, unsigned int proposal, \
+ *   unsigned int walker, unsigned int complementary, double z)
+ * \brief Function to build a stretch move proposal.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param proposal
+ * \brief Simulation number of the proposal.
+ * \param walker
+ * \brief Simulation number of the moved walker.
+ * \param complementary
+ * \brief Simulation number of the walker of the complementary half.
+ * \param z
+ * \brief Stretch factor.
+ * \return 1 if the proposal is inside the variable ranges, 0 otherwise.
+ */
+int calibrate_mcmc_stretch(Calibrate *calibrate, unsigned int proposal,
+	unsigned int walker, unsigned int complementary, double z)
+{
+	unsigned int i;
+	double x, *y;
+	y = calibrate->value + proposal * calibrate->nvariables;
+	for (i = 0; i < calibrate->nvariables; ++i)
+	{
+		x = calibrate->value[complementary * calibrate->nvariables + i];
+		y[i] = x
+			+ z * (calibrate->value[walker * calibrate->nvariables + i] - x);
+		if (y[i] < calibrate->rangemin[i] || y[i] > calibrate->rangemax[i])
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * \fn double calibrate_mcmc_logp(double s, double e)
+ * \brief Function to get the log-likelihood of a MCMC walker. The failed or
+ *   cancelled simulations, with NaN objective function value, are treated as
+ *   the infinite ones.
+ * \param s
+ * \brief Log-likelihood factor of the objective function value.
+ * \param e
+ * \brief Objective function value.
+ * \return Log-likelihood.
+ */
+double calibrate_mcmc_logp(double s, double e)
+{
+	if (isnan(e)) return -INFINITY;
+	return s * e;
+}
+
+/**
+ * \fn void calibrate_mcmc(Calibrate *calibrate)
+ * \brief Function to sample the posterior distribution of the variables with
+ *   the affine-invariant ensemble sampler of Goodman and Weare (stretch
+ *   moves). The two halves of the ensemble are updated alternately, all the
+ *   proposals of a half being simulated in parallel. The likelihood is
+ *   exp(-objective/(2*noise^2)) with a uniform prior on the variable ranges,
+ *   null on the failed simulations.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_mcmc(Calibrate *calibrate)
+{
+	unsigned int i, j, k, l, m, n, h, nsteps, nvariables, *proposal, *accepted;
+	double x, s, *value, *logp, *z, *mean;
+	FILE *file;
+#if DEBUG
+printf("calibrate_mcmc: start\n");
+#endif
+
+	// Walkers on the first simulation numbers and proposals on the next ones
+	n = calibrate->nsimulations;
+	h = n / 2;
+	nsteps = calibrate->niterations;
+	nvariables = calibrate->nvariables;
+	value = calibrate->value;
+	s = -0.5 / (calibrate->noise * calibrate->noise);
+	proposal = (unsigned int*)malloc(h * sizeof(unsigned int));
+	accepted = (unsigned int*)malloc(n * sizeof(unsigned int));
+	logp = (double*)malloc(n * sizeof(double));
+	z = (double*)malloc(h * sizeof(double));
+	mean = (double*)malloc((nsteps + 1) * nvariables * sizeof(double));
+
+	// Opening the chain file, stopping on all tasks on errors
+	file = NULL;
+	k = 1;
+#ifdef HAVE_MPI
+	if (!calibrate->mpi_rank)
+#endif
+	{
+		file = fopen(calibrate->chain, "wb");
+		if (!file)
+		{
+			printf("Unable to open the chain file %s\n", calibrate->chain);
+			k = 0;
+		}
+		else
+		{
+			fwrite(&n, sizeof(unsigned int), 1, file);
+			fwrite(&nvariables, sizeof(unsigned int), 1, file);
+			fwrite(&nsteps, sizeof(unsigned int), 1, file);
+		}
+	}
+#ifdef HAVE_MPI
+	MPI_Bcast(&k, 1, MPI_UNSIGNED, 0, calibrate->mpi_comm);
+#endif
+	if (!k)
+	{
+		free(mean);
+		free(z);
+		free(logp);
+		free(accepted);
+		free(proposal);
+		return;
+	}
+
+	// Initial walkers
+	for (i = 0; i < n; ++i)
+	{
+		accepted[i] = 0;
+		for (j = 0; j < nvariables; ++j)
+			value[i * nvariables + j] = calibrate->rangemin[j]
+				+ gsl_rng_uniform(rng)
+				* (calibrate->rangemax[j] - calibrate->rangemin[j]);
+	}
+	calibrate_run(calibrate, 0, n);
+	for (i = 0; i < n; ++i)
+		logp[i] = calibrate_mcmc_logp(s, calibrate->error[i]);
+
+	for (l = 0;; ++l)
+	{
+		// Saving the step
+		for (j = 0; j < nvariables; ++j)
+		{
+			for (i = 0, x = 0.; i < n; ++i) x += value[i * nvariables + j];
+			mean[l * nvariables + j] = x / n;
+		}
+		if (file)
+			for (i = 0; i < n; ++i)
+			{
+				fwrite(value + i * nvariables, sizeof(double), nvariables,
+					file);
+				fwrite(logp + i, sizeof(double), 1, file);
+			}
+		if (l == nsteps) break;
+		if (calibrate->halt)
+		{
+			nsteps = l;
+			break;
+		}
+#if DEBUG
+printf("calibrate_mcmc: step=%u\n", l + 1);
+#endif
+
+		// Updating each half of the ensemble with the complementary half
+		for (k = 0; k < 2; ++k)
+		{
+			// Proposals out of the variable ranges are rejected without
+			// simulating them
+			for (i = k * h, m = 0; i < k * h + h; ++i)
+			{
+				j = (1 - k) * h + gsl_rng_uniform_int(rng, h);
+				x = (calibrate->stretch - 1.) * gsl_rng_uniform(rng) + 1.;
+				z[m] = x * x / calibrate->stretch;
+				if (calibrate_mcmc_stretch(calibrate, n + m, i, j, z[m]))
+					proposal[m++] = i;
+			}
+			calibrate_run(calibrate, n, n + m);
+
+			// Accepting or rejecting the proposals
+			for (i = 0; i < m; ++i)
+			{
+				j = proposal[i];
+				x = calibrate_mcmc_logp(s, calibrate->error[n + i]);
+				if (log(gsl_rng_uniform_pos(rng))
+					< (nvariables - 1) * log(z[i]) + x - logp[j])
+				{
+					memcpy(value + j * nvariables, value + (n + i) * nvariables,
+						nvariables * sizeof(double));
+					logp[j] = x;
+					++accepted[j];
+				}
+			}
+		}
+	}
+
+	// Diagnostics
+	if (file)
+	{
+		// Rewriting the number of steps of a chain stopped by steering
+		fseek(file, 2 * sizeof(unsigned int), SEEK_SET);
+		fwrite(&nsteps, sizeof(unsigned int), 1, file);
+		fclose(file);
+		for (i = 0, x = 0.; i < n; ++i) x += accepted[i];
+		printf("MCMC walkers=%u steps=%u acceptance fraction=%lg\n", n, nsteps,
+			nsteps ? x / (n * nsteps) : 0.);
+		for (j = 0; j < nvariables; ++j)
+		{
+			x = calibrate_autocorrelation(mean + j, nsteps + 1, nvariables);
+			printf("%s: autocorrelation time=%lg effective samples=%lg\n",
+				calibrate->label[j], x, n * (nsteps + 1) / x);
+		}
+	}
+	free(mean);
+	free(z);
+	free(logp);
+	free(accepted);
+	free(proposal);
+
+#if DEBUG
+printf("calibrate_mcmc: end\n");
+#endif
+}
+
+/**
+ * \fn void calibrate_abc_propose(Calibrate *calibrate, Abc *abc, \
+ *   unsigned int simulation)
+ * \brief Function to propose a particle sampling the prior on the first
+ *   population or resampling and perturbing the previous population.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param abc
+ * \brief ABC-SMC population data pointer.
+ * \param simulation
+ * \brief Simulation number to save the proposal.
+ */
+void calibrate_abc_propose(Calibrate *calibrate, Abc *abc,
+	unsigned int simulation)
+{
+	unsigned int i, j, k, n;
+	double x, *y;
+	y = calibrate->value + simulation * calibrate->nvariables;
+	if (!abc->iteration)
+	{
+		for (i = 0; i < calibrate->nvariables; ++i)
+			y[i] = calibrate->rangemin[i] + gsl_rng_uniform(abc->rng)
+				* (calibrate->rangemax[i] - calibrate->rangemin[i]);
+		return;
+	}
+	n = calibrate->nsimulations;
+	do
+	{
+		// Weighted resampling by bisection on the cumulative weights
+		x = gsl_rng_uniform(abc->rng);
+		for (j = 0, k = n - 1; j < k;)
+		{
+			i = (j + k) / 2;
+			if (abc->weight_old[i] <= x) j = i + 1;
+			else k = i;
+		}
+
+		// Perturbation
+		for (i = 0; i < calibrate->nvariables; ++i)
+		{
+			y[i] = abc->particle_old[j * calibrate->nvariables + i]
+				+ gsl_ran_gaussian(abc->rng, abc->sigma[i]);
+			if (y[i] < calibrate->rangemin[i] || y[i] > calibrate->rangemax[i])
+				break;
+		}
+	}
+	while (i < calibrate->nvariables);
+}
+
+/**
+ * \fn int calibrate_abc_open(Abc *abc)
+ * \brief Function to check if the population takes new proposals. The mutex
+ *   has to be locked.
+ * \param abc
+ * \brief ABC-SMC population data pointer.
+ * \return 1 if the population takes new proposals, 0 otherwise.
+ */
+int calibrate_abc_open(Abc *abc)
+{
+	return abc->open && abc->naccepted < abc->ntarget
+		&& abc->ntrials < abc->nmaximum;
+}
+
+/**
+ * \fn void calibrate_abc_worker(ParallelData *data)
+ * \brief Function to accept ABC-SMC particles on a thread. Proposals are
+ *   simulated asynchronously until the number of particles to accept on the
+ *   task is reached. With threads, the worker waits for the next population
+ *   and the proposals finished when their population is closed are
+ *   discarded, so the next population does not wait for them. The failed
+ *   proposals are never accepted.
+ * \param data
+ * \brief Function data.
+ */
+void calibrate_abc_worker(ParallelData *data)
+{
+	unsigned int i, j, k, simulation, iteration;
+	double e;
+	Calibrate *calibrate;
+	Abc *abc;
+#if DEBUG
+printf("calibrate_abc_worker: start\n");
+#endif
+	calibrate = data->calibrate;
+	abc = (Abc*)data->data;
+	simulation = data->thread;
+#ifdef HAVE_MPI
+	simulation += calibrate->mpi_rank * calibrate->nthreads;
+#endif
+	g_mutex_lock(&mutex);
+	while (!abc->end)
+	{
+		// Waiting for a population taking proposals
+		if (!calibrate_abc_open(abc))
+		{
+			if (calibrate->nthreads <= 1) break;
+			g_cond_wait(&cond, &mutex);
+			continue;
+		}
+
+		calibrate_abc_propose(calibrate, abc, simulation);
+		iteration = abc->iteration;
+		++abc->ntrials;
+		++abc->nrunning;
+		g_mutex_unlock(&mutex);
+		for (j = 0;; ++j)
+		{
+			e = calibrate_objective(calibrate, simulation, &k);
+			if (k != FAILURE_TRANSIENT) break;
+
+			// Retrying transient failures
+			g_mutex_lock(&mutex);
+			if (j >= calibrate->retries) ++calibrate->nexhausted;
+			else ++calibrate->nretried;
+			g_mutex_unlock(&mutex);
+			if (j >= calibrate->retries) break;
+		}
+		g_mutex_lock(&mutex);
+		--abc->nrunning;
+		calibrate->error[simulation] = e;
+		calibrate_best(calibrate, simulation, e);
+		if (abc->open && iteration == abc->iteration && isfinite(e)
+			&& e <= abc->epsilon && abc->naccepted < abc->ntarget)
+		{
+			i = abc->first + abc->naccepted;
+			memcpy(abc->particle + i * calibrate->nvariables,
+				calibrate->value + simulation * calibrate->nvariables,
+				calibrate->nvariables * sizeof(double));
+			abc->distance[i] = e;
+			++abc->naccepted;
+		}
+		g_cond_broadcast(&cond);
+#if DEBUG
+printf("calibrate_abc_worker: simulation=%u e=%lg accepted=%u\n", simulation,
+e, abc->naccepted);
+#endif
+	}
+	g_mutex_unlock(&mutex);
+#if DEBUG
+printf("calibrate_abc_worker: end\n");
+#endif
+}
+
+/**
+ * \fn void* calibrate_abc_thread(ParallelData *data)
+ * \brief Function to accept ABC-SMC particles on a GThread.
+ * \param data
+ * \brief Function data.
+ * \return NULL
+ */
+void* calibrate_abc_thread(ParallelData *data)
+{
+	calibrate_abc_worker(data);
+	g_thread_exit(NULL);
+	return NULL;
+}
+
+/**
+ * \fn int calibrate_compare(const void *a, const void *b)
+ * \brief Function to compare two doubles to sort them with qsort.
+ * \param a
+ * \brief Pointer to the first double.
+ * \param b
+ * \brief Pointer to the second double.
+ * \return -1 if the first double is lower, 1 if it is greater, 0 otherwise.
+ */
+int calibrate_compare(const void *a, const void *b)
+{
+	double x, y;
+	x = *(double*)a;
+	y = *(double*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * \fn void calibrate_abc_weights(Calibrate *calibrate, Abc *abc)
+ * \brief Function to calculate the weights of a new ABC-SMC population.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param abc
+ * \brief ABC-SMC population data pointer.
+ */
+void calibrate_abc_weights(Calibrate *calibrate, Abc *abc)
+{
+	unsigned int i, j, k, n, nvariables;
+	double x, y, w, z;
+	n = calibrate->nsimulations;
+	nvariables = calibrate->nvariables;
+	for (i = 0, z = 0.; i < n; ++i)
+	{
+		if (!abc->iteration) w = 1.;
+		else
+		{
+			// Uniform prior divided by the mixture of perturbation kernels
+			for (j = 0, w = 0.; j < n; ++j)
+			{
+				for (k = 0, x = 0.; k < nvariables; ++k)
+				{
+					y = (abc->particle[i * nvariables + k]
+						- abc->particle_old[j * nvariables + k])
+						/ abc->sigma[k];
+					x += y * y;
+				}
+				y = abc->weight_old[j];
+				if (j) y -= abc->weight_old[j - 1];
+				w += y * exp(-0.5 * x);
+			}
+			w = 1. / w;
+		}
+		abc->weight[i] = w;
+		z += w;
+	}
+	for (i = 0; i < n; ++i) abc->weight[i] /= z;
+}
+
+/**
+ * \fn void calibrate_abc(Calibrate *calibrate)
+ * \brief Function to calibrate with the approximate Bayesian computation
+ *   sequential Monte-Carlo algorithm. The tolerance of every population is a
+ *   quantile of the previous population distances. The particles of a
+ *   population are simulated asynchronously on the threads until the
+ *   acceptance target of every task is reached, and the threads go on with
+ *   the next population without waiting for the proposals in simulation.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_abc(Calibrate *calibrate)
+{
+	unsigned int i, j, n, nvariables, ntrials, npopulations;
+	double x, y, *sorted;
+	Abc abc[1];
+	FILE *file;
+	GThread *thread[calibrate->nthreads];
+	ParallelData data[calibrate->nthreads];
+#ifdef HAVE_MPI
+	unsigned int k;
+	int count[calibrate->mpi_tasks], displacement[calibrate->mpi_tasks],
+		count2[calibrate->mpi_tasks], displacement2[calibrate->mpi_tasks];
+#endif
+#if DEBUG
+printf("calibrate_abc: start\n");
+#endif
+
+	// Allocating the populations
+	n = calibrate->nsimulations;
+	nvariables = calibrate->nvariables;
+	abc->particle = (double*)malloc(n * nvariables * sizeof(double));
+	abc->particle_old = (double*)malloc(n * nvariables * sizeof(double));
+	abc->weight = (double*)malloc(n * sizeof(double));
+	abc->weight_old = (double*)malloc(n * sizeof(double));
+	abc->distance = (double*)malloc(n * sizeof(double));
+	abc->sigma = (double*)alloca(nvariables * sizeof(double));
+	sorted = (double*)malloc(n * sizeof(double));
+
+	// Particles to accept on each task with an independent random numbers
+	// generator
+	abc->rng = gsl_rng_alloc(gsl_rng_taus2);
+#ifdef HAVE_MPI
+	gsl_rng_set(abc->rng, RANDOM_SEED + 1 + calibrate->mpi_rank);
+	for (k = 0; k < calibrate->mpi_tasks; ++k)
+	{
+		displacement[k] = k * n / calibrate->mpi_tasks;
+		count[k] = (k + 1) * n / calibrate->mpi_tasks - displacement[k];
+		displacement2[k] = displacement[k] * nvariables;
+		count2[k] = count[k] * nvariables;
+	}
+	abc->first = displacement[calibrate->mpi_rank];
+	abc->ntarget = count[calibrate->mpi_rank];
+#else
+	gsl_rng_set(abc->rng, RANDOM_SEED + 1);
+	abc->first = 0;
+	abc->ntarget = n;
+#endif
+	abc->nmaximum = ABC_TRIALS * abc->ntarget;
+
+	// Starting the threads, waiting for the first population
+	abc->open = abc->end = abc->nrunning = 0;
+	for (i = 0; i < calibrate->nthreads; ++i)
+	{
+		data[i].calibrate = calibrate;
+		data[i].data = abc;
+		data[i].thread = i;
+	}
+	if (calibrate->nthreads > 1)
+		for (i = 0; i < calibrate->nthreads; ++i)
+			thread[i] = g_thread_new(NULL, (void(*))calibrate_abc_thread,
+				&data[i]);
+
+	for (abc->iteration = npopulations = 0, abc->epsilon = INFINITY;
+		abc->iteration < calibrate->niterations; ++abc->iteration)
+	{
+		// Accepting particles, without waiting for the proposals in
+		// simulation when the population is complete
+		g_mutex_lock(&mutex);
+		abc->naccepted = abc->ntrials = 0;
+		abc->open = 1;
+		if (calibrate->nthreads <= 1)
+		{
+			g_mutex_unlock(&mutex);
+			calibrate_abc_worker(data);
+			g_mutex_lock(&mutex);
+		}
+		else
+		{
+			g_cond_broadcast(&cond);
+			while (abc->naccepted < abc->ntarget
+				&& (abc->ntrials < abc->nmaximum || abc->nrunning))
+				g_cond_wait(&cond, &mutex);
+		}
+		abc->open = 0;
+		g_mutex_unlock(&mutex);
+
+		// Checking that the population is complete
+		i = (abc->naccepted == abc->ntarget);
+		ntrials = abc->ntrials;
+#ifdef HAVE_MPI
+		MPI_Allreduce(MPI_IN_PLACE, &i, 1, MPI_UNSIGNED, MPI_MIN,
+			calibrate->mpi_comm);
+		MPI_Allreduce(MPI_IN_PLACE, &ntrials, 1, MPI_UNSIGNED, MPI_SUM,
+			calibrate->mpi_comm);
+#endif
+		if (!i)
+		{
+#ifdef HAVE_MPI
+			if (!calibrate->mpi_rank)
+#endif
+			printf("ABC population=%u not completed in %u proposals\n",
+				abc->iteration, ntrials);
+			break;
+		}
+
+#ifdef HAVE_MPI
+		// Sharing the population
+		MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, abc->particle,
+			count2, displacement2, MPI_DOUBLE, calibrate->mpi_comm);
+		MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, abc->distance,
+			count, displacement, MPI_DOUBLE, calibrate->mpi_comm);
+#endif
+
+		// Weights
+		calibrate_abc_weights(calibrate, abc);
+		for (i = 0, x = 0.; i < n; ++i) x += abc->weight[i] * abc->weight[i];
+#ifdef HAVE_MPI
+		if (!calibrate->mpi_rank)
+#endif
+		printf("ABC population=%u tolerance=%le acceptance=%lg "
+			"effective particles=%lg\n", abc->iteration, abc->epsilon,
+			(double)n / ntrials, 1. / x);
+
+		// Saving the population as the previous one
+		memcpy(abc->particle_old, abc->particle,
+			n * nvariables * sizeof(double));
+		for (i = 0, x = 0.; i < n; ++i)
+			abc->weight_old[i] = x += abc->weight[i];
+		++npopulations;
+		if (abc->epsilon <= calibrate->tolerance) break;
+
+		// Perturbation kernel with twice the weighted variance
+		for (j = 0; j < nvariables; ++j)
+		{
+			for (i = 0, x = 0.; i < n; ++i)
+				x += abc->weight[i] * abc->particle[i * nvariables + j];
+			for (i = 0, abc->sigma[j] = 0.; i < n; ++i)
+			{
+				y = abc->particle[i * nvariables + j] - x;
+				abc->sigma[j] += abc->weight[i] * y * y;
+			}
+			abc->sigma[j] = sqrt(2. * abc->sigma[j]);
+			if (abc->sigma[j] <= 0.)
+				abc->sigma[j] = DBL_EPSILON
+					* (calibrate->rangemax[j] - calibrate->rangemin[j]);
+		}
+
+		// Next tolerance
+		memcpy(sorted, abc->distance, n * sizeof(double));
+		qsort(sorted, n, sizeof(double), calibrate_compare);
+		abc->epsilon = fmax(sorted[(unsigned int)(calibrate->quantile
+			* (n - 1))], calibrate->tolerance);
+	}
+
+	// Finishing the threads
+	if (calibrate->nthreads > 1)
+	{
+		g_mutex_lock(&mutex);
+		abc->end = 1;
+		g_cond_broadcast(&cond);
+		g_mutex_unlock(&mutex);
+		for (i = 0; i < calibrate->nthreads; ++i) g_thread_join(thread[i]);
+	}
+
+	// Saving the last population
+#ifdef HAVE_MPI
+	if (!calibrate->mpi_rank && npopulations)
+#else
+	if (npopulations)
+#endif
+	{
+		file = fopen(calibrate->population, "w");
+		if (!file)
+			printf("Unable to open the population file %s\n",
+				calibrate->population);
+		else
+		{
+			for (i = 0; i < n; ++i)
+			{
+				for (j = 0; j < nvariables; ++j)
+				{
+					fprintf(file, calibrate->format[j],
+						abc->particle_old[i * nvariables + j]);
+					fprintf(file, " ");
+				}
+				x = abc->weight_old[i];
+				if (i) x -= abc->weight_old[i - 1];
+				fprintf(file, "%le\n", x);
+			}
+			fclose(file);
+		}
+	}
+
+	// Freeing memory
+	gsl_rng_free(abc->rng);
+	free(sorted);
+	free(abc->distance);
+	free(abc->weight_old);
+	free(abc->weight);
+	free(abc->particle_old);
+	free(abc->particle);
+
+#if DEBUG
+printf("calibrate_abc: end\n");
+#endif
+}
+
+/**
+ * \fn void calibrate_sobol_sample(Calibrate *calibrate, gsl_rng *r, \
+ *   unsigned int sample, unsigned int simulation)
+ * \brief Function to generate the Saltelli sample of a base sample number:
+ *   rows of the A, B and AB_i matrices. Every base sample is generated from
+ *   its number, without storing the matrices.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param r
+ * \brief Pseudo-random numbers generator.
+ * \param sample
+ * \brief Base sample number.
+ * \param simulation
+ * \brief Simulation number of the A row, followed by the B and AB_i rows.
+ */
+void calibrate_sobol_sample(Calibrate *calibrate, gsl_rng *r,
+	unsigned int sample, unsigned int simulation)
+{
+	unsigned int i, j, nvariables;
+	double *a, *b, *ab;
+	nvariables = calibrate->nvariables;
+	a = calibrate->value + simulation * nvariables;
+	b = a + nvariables;
+	gsl_rng_set(r, RANDOM_SEED + 1 + sample);
+	for (i = 0; i < nvariables; ++i)
+		a[i] = calibrate->rangemin[i] + gsl_rng_uniform(r)
+			* (calibrate->rangemax[i] - calibrate->rangemin[i]);
+	for (i = 0; i < nvariables; ++i)
+		b[i] = calibrate->rangemin[i] + gsl_rng_uniform(r)
+			* (calibrate->rangemax[i] - calibrate->rangemin[i]);
+	for (i = 0; i < nvariables; ++i)
+	{
+		ab = b + (i + 1) * nvariables;
+		for (j = 0; j < nvariables; ++j) ab[j] = a[j];
+		ab[i] = b[i];
+	}
+}
+
+/**
+ * \fn void calibrate_sobol_add(double *sum, unsigned int nvariables, \
+ *   double w, double *f, double reference)
+ * \brief Function to add a weighted Saltelli sample to a Sobol indices
+ *   accumulator. The objective function values are shifted by a reference
+ *   value to avoid the cancellation of the variance of large values.
+ * \param sum
+ * \brief Accumulator: weights, f(A), f(B), f(A)^2 and f(B)^2 sums (shifted by
+ *   the reference), followed by the first order and total sums of every
+ *   variable.
+ * \param nvariables
+ * \brief Variables number.
+ * \param w
+ * \brief Weight.
+ * \param f
+ * \brief Objective function values of the A, B and AB_i rows.
+ * \param reference
+ * \brief Reference objective function value.
+ */
+void calibrate_sobol_add(double *sum, unsigned int nvariables, double w,
+	double *f, double reference)
+{
+	unsigned int i;
+	double a, b, x;
+	a = f[0] - reference;
+	b = f[1] - reference;
+	sum[0] += w;
+	sum[1] += w * a;
+	sum[2] += w * b;
+	sum[3] += w * a * a;
+	sum[4] += w * b * b;
+	for (i = 0; i < nvariables; ++i)
+	{
+		x = f[i + 2] - f[0];
+		sum[5 + i] += w * b * x;
+		sum[5 + nvariables + i] += w * x * x;
+	}
+}
+
+/**
+ * \fn void calibrate_sobol_indices(double *sum, unsigned int nvariables, \
+ *   double *first, double *total)
+ * \brief Function to calculate the Sobol indices of an accumulator with the
+ *   Saltelli (first order) and Jansen (total) estimators. The sums of the
+ *   objective function values are shifted by the reference of the
+ *   accumulator, so the variance is not cancelled by a large mean.
+ * \param sum
+ * \brief Accumulator.
+ * \param nvariables
+ * \brief Variables number.
+ * \param first
+ * \brief Array of first order indices.
+ * \param total
+ * \brief Array of total indices.
+ */
+void calibrate_sobol_indices(double *sum, unsigned int nvariables,
+	double *first, double *total)
+{
+	unsigned int i;
+	double mean, variance;
+	mean = 0.5 * (sum[1] + sum[2]) / sum[0];
+	variance = 0.5 * (sum[3] + sum[4]) / sum[0] - mean * mean;
+	for (i = 0; i < nvariables; ++i)
+	{
+		first[i] = sum[5 + i] / (sum[0] * variance);
+		total[i] = 0.5 * sum[5 + nvariables + i] / (sum[0] * variance);
+	}
+}
+
+/**
+ * \fn void calibrate_sobol(Calibrate *calibrate)
+ * \brief Function to perform a variance-based Sobol sensitivity analysis with
+ *   Saltelli sampling. The samples are generated and simulated in parallel by
+ *   blocks and the indices are accumulated on the fly, with bootstrap
+ *   confidence intervals obtained by Poisson weights. The base samples with
+ *   failed simulations are excluded.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_sobol(Calibrate *calibrate)
+{
+	unsigned int i, j, k, n, m, nblock, nvariables, nbootstraps, nfailed;
+	double reference, *sum, *first, *total, *replicate, *f;
+	gsl_rng *r;
+#if DEBUG
+printf("calibrate_sobol: start\n");
+#endif
+
+	// Accumulators of the sample and of every bootstrap replicate
+	nvariables = calibrate->nvariables;
+	nbootstraps = calibrate->nbootstraps;
+	m = 5 + 2 * nvariables;
+	sum = (double*)calloc((nbootstraps + 1) * m, sizeof(double));
+	first = (double*)alloca(nvariables * sizeof(double));
+	total = (double*)alloca(nvariables * sizeof(double));
+	r = gsl_rng_alloc(gsl_rng_taus2);
+
+	// A base sample per thread of every task on each block
+	nblock = calibrate->nthreads;
+#ifdef HAVE_MPI
+	nblock *= calibrate->mpi_tasks;
+#endif
+	reference = NAN;
+	for (n = nfailed = 0; n < calibrate->nsimulations; n += nblock)
+	{
+		if (n + nblock > calibrate->nsimulations)
+			nblock = calibrate->nsimulations - n;
+		for (k = 0; k < nblock; ++k)
+			calibrate_sobol_sample(calibrate, r, n + k, k * (nvariables + 2));
+		calibrate_run(calibrate, 0, nblock * (nvariables + 2));
+		for (k = 0; k < nblock; ++k)
+		{
+			// Excluding the base samples with failed simulations
+			f = calibrate->error + k * (nvariables + 2);
+			for (i = 0; i < nvariables + 2 && isfinite(f[i]); ++i);
+			if (i < nvariables + 2)
+			{
+				++nfailed;
+				continue;
+			}
+
+			// The first sample is the reference of all the accumulators
+			if (isnan(reference)) reference = f[0];
+			calibrate_sobol_add(sum, nvariables, 1., f, reference);
+			for (i = 1; i <= nbootstraps; ++i)
+			{
+				j = gsl_ran_poisson(rng, 1.);
+				if (j)
+					calibrate_sobol_add(sum + i * m, nvariables, j, f,
+						reference);
+			}
+		}
+	}
+
+	// Indices and confidence intervals
+#ifdef HAVE_MPI
+	if (!calibrate->mpi_rank)
+#endif
+	{
+		replicate = (double*)malloc(2 * nvariables * nbootstraps
+			* sizeof(double));
+		for (i = 1; i <= nbootstraps; ++i)
+			calibrate_sobol_indices(sum + i * m, nvariables,
+				replicate + (i - 1) * 2 * nvariables,
+				replicate + ((i - 1) * 2 + 1) * nvariables);
+		calibrate_sobol_indices(sum, nvariables, first, total);
+		printf("SOBOL INDICES (%u base samples, %u bootstrap replicates, "
+			"%lg%% confidence intervals)\n", calibrate->nsimulations - nfailed,
+			nbootstraps, 100. * SOBOL_CONFIDENCE);
+		if (nfailed)
+			printf("excluded base samples with failed simulations=%u\n",
+				nfailed);
+		f = (double*)alloca(2 * nbootstraps * sizeof(double));
+		for (i = 0; i < nvariables; ++i)
+		{
+			for (j = 0; j < nbootstraps; ++j)
+			{
+				f[j] = replicate[2 * j * nvariables + i];
+				f[nbootstraps + j] = replicate[(2 * j + 1) * nvariables + i];
+			}
+			printf("%s: first order=%lg", calibrate->label[i], first[i]);
+			if (nbootstraps)
+			{
+				qsort(f, nbootstraps, sizeof(double), calibrate_compare);
+				printf(" [%lg, %lg]",
+					f[(unsigned int)(0.5 * (1. - SOBOL_CONFIDENCE)
+						* (nbootstraps - 1))],
+					f[(unsigned int)(0.5 * (1. + SOBOL_CONFIDENCE)
+						* (nbootstraps - 1) + 0.5)]);
+			}
+			printf(" total=%lg", total[i]);
+			if (nbootstraps)
+			{
+				qsort(f + nbootstraps, nbootstraps, sizeof(double),
+					calibrate_compare);
+				printf(" [%lg, %lg]",
+					f[nbootstraps + (unsigned int)(0.5 * (1. - SOBOL_CONFIDENCE)
+						* (nbootstraps - 1))],
+					f[nbootstraps + (unsigned int)(0.5 * (1. + SOBOL_CONFIDENCE)
+						* (nbootstraps - 1) + 0.5)]);
+			}
+			printf("\n");
+		}
+		free(replicate);
+	}
+
+	// Freeing memory
+	gsl_rng_free(r);
+	free(sum);
+
+#if DEBUG
+printf("calibrate_sobol: end\n");
+#endif
+}
+
+/**
+ * \fn void calibrate_portfolio_propose(Calibrate *calibrate, \
+ *   Portfolio *portfolio, unsigned int arm, unsigned int simulation)
+ * \brief Function to propose the variable values of a simulation with the
+ *   search algorithm of a portfolio arm.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param portfolio
+ * \brief Portfolio data pointer.
+ * \param arm
+ * \brief Portfolio arm.
+ * \param simulation
+ * \brief Simulation number.
+ */
+void calibrate_portfolio_propose(Calibrate *calibrate, Portfolio *portfolio,
+	unsigned int arm, unsigned int simulation)
+{
+	unsigned int j, a, b, c, r, l, n, nvariables;
+	double x, w, *value, *best;
+	static const unsigned int nneeded[PORTFOLIO_ARMS] = {0, 2, 1, 4};
+	nvariables = calibrate->nvariables;
+	value = calibrate->value + simulation * nvariables;
+	best = calibrate->value_best;
+	n = calibrate->nsaveds;
+
+	// Monte-Carlo proposal, also if the arm has not bests enough
+	if (arm == PORTFOLIO_ARM_MONTE_CARLO || n < nneeded[arm])
+	{
+		for (j = 0; j < nvariables; ++j)
+			value[j] = calibrate->rangemin[j] + gsl_rng_uniform(rng)
+				* (calibrate->rangemax[j] - calibrate->rangemin[j]);
+		return;
+	}
+
+	switch (arm)
+	{
+		// Box around the bests
+		case PORTFOLIO_ARM_REFINE:
+			for (j = 0; j < nvariables; ++j)
+			{
+				x = w = best[j];
+				for (a = 1; a < n; ++a)
+				{
+					x = fmin(x, best[a * nvariables + j]);
+					w = fmax(w, best[a * nvariables + j]);
+				}
+				w -= x;
+				x -= PORTFOLIO_EXPAND * w;
+				w += 2. * PORTFOLIO_EXPAND * w;
+				value[j] = x + w * gsl_rng_uniform(rng);
+			}
+			break;
+
+		// Gaussian local search around the best
+		case PORTFOLIO_ARM_LOCAL:
+			for (j = 0; j < nvariables; ++j)
+				value[j] = best[j] + gsl_ran_gaussian(rng, portfolio->step
+					* (calibrate->rangemax[j] - calibrate->rangemin[j]));
+			break;
+
+		// Differential evolution of the bests
+		default:
+			a = gsl_rng_uniform_int(rng, n);
+			do b = gsl_rng_uniform_int(rng, n); while (b == a);
+			do c = gsl_rng_uniform_int(rng, n); while (c == a || c == b);
+			r = gsl_rng_uniform_int(rng, n);
+			l = gsl_rng_uniform_int(rng, nvariables);
+			for (j = 0; j < nvariables; ++j)
+			{
+				if (j == l || gsl_rng_uniform(rng) < PORTFOLIO_CROSSOVER)
+					value[j] = best[a * nvariables + j]
+						+ PORTFOLIO_DIFFERENTIAL * (best[b * nvariables + j]
+						- best[c * nvariables + j]);
+				else value[j] = best[r * nvariables + j];
+			}
+	}
+
+	// Keeping the proposal in the variable ranges
+	for (j = 0; j < nvariables; ++j)
+		value[j] = fmin(calibrate->rangemax[j],
+			fmax(calibrate->rangemin[j], value[j]));
+}
+
+/**
+ * \fn unsigned int calibrate_portfolio_arm(Portfolio *portfolio)
+ * \brief Function to select the portfolio arm of the next simulation slot by
+ *   the discounted upper confidence bound bandit rule. The slots assigned to
+ *   the batch count as pulls without reward.
+ * \param portfolio
+ * \brief Portfolio data pointer.
+ * \return Portfolio arm.
+ */
+unsigned int calibrate_portfolio_arm(Portfolio *portfolio)
+{
+	unsigned int i, arm;
+	double n, u, umax;
+	for (i = 0, n = 0.; i < PORTFOLIO_ARMS; ++i)
+		n += portfolio->pulls[i] + portfolio->slots[i];
+	for (i = arm = 0, umax = -INFINITY; i < PORTFOLIO_ARMS; ++i)
+	{
+		if (portfolio->pulls[i] + portfolio->slots[i] <= 0.) return i;
+		u = sqrt(PORTFOLIO_EXPLORATION * log(n)
+			/ (portfolio->pulls[i] + portfolio->slots[i]));
+		if (portfolio->pulls[i] > 0.)
+			u += portfolio->rewards[i] / portfolio->pulls[i];
+		if (u > umax)
+		{
+			umax = u;
+			arm = i;
+		}
+	}
+	return arm;
+}
+
+/**
+ * \fn void calibrate_portfolio(Calibrate *calibrate)
+ * \brief Function to calibrate with a portfolio of search algorithms
+ *   (Monte-Carlo, refinement around the bests, local search and differential
+ *   evolution) sharing the simulation batches, the evaluation cache and the
+ *   bests. The batch slots of every algorithm are allocated by a discounted
+ *   upper confidence bound bandit rewarding the simulations entering in the
+ *   bests.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_portfolio(Calibrate *calibrate)
+{
+	unsigned int i, j, k, l, m, n, nlocal, best_arm;
+	unsigned int *arm, *run;
+	double best, threshold;
+	char key[calibrate->nvariables * VALUE_LENGTH + 1];
+	Portfolio portfolio[1];
+	GHashTable *cache;
+	static const char *label[PORTFOLIO_ARMS]
+		= {"Monte-Carlo", "refine", "local", "evolution"};
+#if DEBUG
+printf("calibrate_portfolio: start\n");
+#endif
+
+	// Initing the portfolio
+	n = calibrate->nsimulations;
+	arm = (unsigned int*)malloc(n * sizeof(unsigned int));
+	run = (unsigned int*)malloc(n * sizeof(unsigned int));
+	cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	for (i = 0; i < PORTFOLIO_ARMS; ++i)
+	{
+		portfolio->pulls[i] = portfolio->rewards[i] = 0.;
+		portfolio->nevaluations[i] = portfolio->nhits[i]
+			= portfolio->nscreened[i] = portfolio->nentries[i]
+			= portfolio->nimprovements[i] = 0;
+	}
+	portfolio->step = PORTFOLIO_STEP;
+	best_arm = PORTFOLIO_ARMS;
+	best = INFINITY;
+
+	for (k = 0; k < calibrate->niterations && !calibrate->halt; ++k)
+	{
+		// Proposing the batch, drawing again the cached simulations and the
+		// predicted failures (the last trial is performed anyway, to refine
+		// the failure classifier)
+		calibrate_best_sort(calibrate);
+		for (i = 0; i < PORTFOLIO_ARMS; ++i) portfolio->slots[i] = 0.;
+#ifdef HAVE_MPI
+		if (!calibrate->mpi_rank)
+#endif
+		for (i = 0; i < n; ++i)
+		{
+			j = calibrate_portfolio_arm(portfolio);
+			portfolio->slots[j] += 1.;
+			arm[i] = j;
+			for (l = 0; l < PORTFOLIO_TRIALS; ++l)
+			{
+				calibrate_portfolio_propose(calibrate, portfolio, j, i);
+				calibrate_key(calibrate, i, key);
+				if (g_hash_table_lookup(cache, key)) continue;
+				if (l == PORTFOLIO_TRIALS - 1
+					|| calibrate->failure_threshold >= 1.
+					|| calibrate_failure_probability(calibrate, i)
+					<= calibrate->failure_threshold)
+					break;
+				++portfolio->nscreened[j];
+			}
+			run[i] = (l < PORTFOLIO_TRIALS);
+			if (run[i])
+				g_hash_table_insert(cache, g_strdup(key), g_new(double, 1));
+			else ++portfolio->nhits[j];
+		}
+#ifdef HAVE_MPI
+		// Sharing the batch of the first task, because the failure classifier
+		// can differ on every task
+		MPI_Bcast(calibrate->value, n * calibrate->nvariables, MPI_DOUBLE, 0,
+			calibrate->mpi_comm);
+		MPI_Bcast(arm, n, MPI_UNSIGNED, 0, calibrate->mpi_comm);
+		MPI_Bcast(run, n, MPI_UNSIGNED, 0, calibrate->mpi_comm);
+		if (calibrate->mpi_rank)
+			for (i = 0; i < n; ++i)
+			{
+				portfolio->slots[arm[i]] += 1.;
+				if (!run[i]) continue;
+				calibrate_key(calibrate, i, key);
+				g_hash_table_insert(cache, g_strdup(key), g_new(double, 1));
+			}
+#endif
+
+		// Moving the cached simulations to the end of the batch
+		for (i = m = 0; i < n; ++i)
+			if (run[i])
+			{
+				if (i != m)
+				{
+					memcpy(calibrate->value + m * calibrate->nvariables,
+						calibrate->value + i * calibrate->nvariables,
+						calibrate->nvariables * sizeof(double));
+					arm[m] = arm[i];
+				}
+				++m;
+			}
+
+		// Performing the simulations
+		threshold = (calibrate->nsaveds < calibrate->nbests) ? INFINITY
+			: calibrate->error_best[calibrate->nsaveds - 1];
+		calibrate_run(calibrate, 0, m);
+#ifdef HAVE_MPI
+		// Sharing the bests of all tasks, but not the cancelled or screened
+		// simulations, not admitted by the task performing them
+		for (i = 0; i < m; ++i)
+			if ((i < calibrate->nstart || i >= calibrate->nend)
+				&& !isnan(calibrate->error[i]) && !calibrate->screened[i])
+				calibrate_best(calibrate, i, calibrate->error[i]);
+#endif
+
+		// Rewarding the arms
+		for (i = 0; i < PORTFOLIO_ARMS; ++i)
+		{
+			portfolio->pulls[i] *= PORTFOLIO_DISCOUNT;
+			portfolio->rewards[i] *= PORTFOLIO_DISCOUNT;
+			portfolio->pulls[i] += portfolio->slots[i];
+		}
+		for (i = nlocal = 0; i < m; ++i)
+		{
+			calibrate_key(calibrate, i, key);
+			*(double*)g_hash_table_lookup(cache, key) = calibrate->error[i];
+			++portfolio->nevaluations[arm[i]];
+			if (calibrate->error[i] < threshold)
+			{
+				portfolio->rewards[arm[i]] += 1.;
+				++portfolio->nentries[arm[i]];
+				if (arm[i] == PORTFOLIO_ARM_LOCAL) ++nlocal;
+			}
+			if (calibrate->error[i] < best)
+			{
+				best = calibrate->error[i];
+				best_arm = arm[i];
+				++portfolio->nimprovements[arm[i]];
+			}
+		}
+
+		// Adapting the local search step by the one fifth success rule
+		if (portfolio->slots[PORTFOLIO_ARM_LOCAL] > 0.)
+		{
+			if (nlocal > 0.2 * portfolio->slots[PORTFOLIO_ARM_LOCAL])
+				portfolio->step
+					= fmin(PORTFOLIO_STEP_MAX, 1.5 * portfolio->step);
+			else portfolio->step /= 1.5;
+		}
+#if DEBUG
+printf("calibrate_portfolio: batch=%u simulations=%u best=%le step=%le\n",
+k, m, best, portfolio->step);
+#endif
+	}
+
+#ifdef HAVE_MPI
+	// The bests of every task are the bests of all tasks
+	if (calibrate->mpi_rank) calibrate->nsaveds = 0;
+	if (!calibrate->mpi_rank)
+#endif
+	{
+		// Showing the contribution of every arm
+		for (i = 0; i < PORTFOLIO_ARMS; ++i)
+			printf("portfolio arm=%s simulations=%u cached=%u screened=%u"
+				" bests entries=%u best improvements=%u last slots=%.0lf\n",
+				label[i], portfolio->nevaluations[i], portfolio->nhits[i],
+				portfolio->nscreened[i], portfolio->nentries[i],
+				portfolio->nimprovements[i], portfolio->slots[i]);
+		if (best_arm < PORTFOLIO_ARMS)
+			printf("portfolio best found by arm=%s\n", label[best_arm]);
+	}
+
+	// Freeing memory
+	g_hash_table_destroy(cache);
+	free(run);
+	free(arm);
+#if DEBUG
+printf("calibrate_portfolio: end\n");
+#endif
+}
+
+/**
+ * \fn unsigned int calibrate_block_size(Calibrate *calibrate, \
+ *   unsigned int group)
+ * \brief Function to get the number of simulations of a block-coordinate
+ *   stage: the sweeps number product if all the variables of the group have
+ *   sweeps, the Monte-Carlo simulations number otherwise.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param group
+ * \brief Group number.
+ * \return Number of simulations.
+ */
+unsigned int calibrate_block_size(Calibrate *calibrate, unsigned int group)
+{
+	unsigned int j, n;
+	for (j = calibrate->group[group], n = 1; j < calibrate->group[group + 1];
+		++j)
+	{
+		if (!calibrate->nsweeps[j]) return calibrate->nsimulations;
+		n *= calibrate->nsweeps[j];
+	}
+	return n;
+}
+
+/**
+ * \fn void calibrate_block_coordinate(Calibrate *calibrate)
+ * \brief Function to calibrate with the block-coordinate algorithm: the
+ *   variables of a group are swept or sampled by Monte-Carlo with the other
+ *   groups fixed at the best values, cycling over the groups until the
+ *   improvement of a cycle is lower than the tolerance.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_block_coordinate(Calibrate *calibrate)
+{
+	unsigned int i, j, k, l, g, n, cycle, nvariables;
+	double e, best, best_old, *x;
+#if DEBUG
+printf("calibrate_block_coordinate: start\n");
+#endif
+
+	// Starting on the center of the variable ranges
+	nvariables = calibrate->nvariables;
+	x = (double*)alloca(nvariables * sizeof(double));
+	for (j = 0; j < nvariables; ++j)
+		x[j] = 0.5 * (calibrate->rangemin[j] + calibrate->rangemax[j]);
+	best = INFINITY;
+
+	for (cycle = 0; cycle < calibrate->niterations && !calibrate->halt; ++cycle)
+	{
+		best_old = best;
+		for (g = 0; g < calibrate->ngroups; ++g)
+		{
+			// Sweeping or sampling the group variables with the other
+			// variables at the best values
+			n = calibrate_block_size(calibrate, g);
+			for (i = 0; i < n; ++i)
+			{
+				memcpy(calibrate->value + i * nvariables, x,
+					nvariables * sizeof(double));
+				for (j = calibrate->group[g], k = i;
+					j < calibrate->group[g + 1]; ++j)
+				{
+					if (!calibrate->nsweeps[j])
+						e = calibrate->rangemin[j] + gsl_rng_uniform(rng)
+							* (calibrate->rangemax[j] - calibrate->rangemin[j]);
+					else
+					{
+						l = k % calibrate->nsweeps[j];
+						k /= calibrate->nsweeps[j];
+						e = calibrate->rangemin[j];
+						if (calibrate->nsweeps[j] > 1)
+							e += l * (calibrate->rangemax[j]
+								- calibrate->rangemin[j])
+								/ (calibrate->nsweeps[j] - 1);
+					}
+					calibrate->value[i * nvariables + j] = e;
+				}
+			}
+			calibrate_run(calibrate, 0, n);
+
+			// Updating the best values
+			for (i = 0; i < n; ++i)
+				if (calibrate->error[i] < best)
+				{
+					best = calibrate->error[i];
+					memcpy(x, calibrate->value + i * nvariables,
+						nvariables * sizeof(double));
+				}
+#if DEBUG
+printf("calibrate_block_coordinate: cycle=%u group=%u simulations=%u "
+"best=%le\n", cycle, g, n, best);
+#endif
+		}
+#ifdef HAVE_MPI
+		if (!calibrate->mpi_rank)
+#endif
+		printf("block-coordinate cycle=%u error=%le\n", cycle, best);
+
+		// Checking the improvement of the cycle
+		if (best_old - best <= calibrate->tolerance) break;
+	}
+
+#if DEBUG
+printf("calibrate_block_coordinate: end\n");
+#endif
+}
+
+/**
+ * \fn void calibrate_sampler_save(Calibrate *calibrate)
+ * \brief Function to save the number of observed batches and simulations, the
+ *   bests and the state of the sampler plugin, writing a temporary file and
+ *   renaming it to keep the previous state on errors. With MPI, only the
+ *   master task saves the state.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_sampler_save(Calibrate *calibrate)
+{
+	int k;
+	FILE *file;
+	Sampler *sampler;
+	char *name;
+#ifdef HAVE_MPI
+	if (calibrate->mpi_rank) return;
+#endif
+	sampler = calibrate->sampler;
+	name = g_strdup_printf("%s.tmp", calibrate->plugin_state);
+	file = fopen(name, "wb");
+	k = file
+		&& fwrite(&sampler->nbatches, sizeof(unsigned int), 1, file) == 1
+		&& fwrite(&sampler->nsimulations, sizeof(unsigned int), 1, file) == 1
+		&& fwrite(&calibrate->nsaveds, sizeof(unsigned int), 1, file) == 1
+		&& fwrite(calibrate->simulation_best, sizeof(unsigned int),
+			calibrate->nsaveds, file) == calibrate->nsaveds
+		&& fwrite(calibrate->error_best, sizeof(double), calibrate->nsaveds,
+			file) == calibrate->nsaveds
+		&& fwrite(calibrate->value_best, sizeof(double),
+			calibrate->nsaveds * calibrate->nvariables, file)
+			== calibrate->nsaveds * calibrate->nvariables
+		&& sampler->save(sampler->data, file);
+	if (file && fclose(file)) k = 0;
+	if (k) rename(name, calibrate->plugin_state);
+	else
+		printf("Unable to save the sampler state %s\n",
+			calibrate->plugin_state);
+	g_free(name);
+}
+
+/**
+ * \fn void calibrate_plugin_worker(ParallelData *data)
+ * \brief Function to drive asynchronously the sampler plugin on a thread. The
+ *   thread asks the sampler for a simulation, performs it on its own slot and
+ *   reports the objective function value to the sampler as soon as it is
+ *   obtained. The state is saved every batch size observed simulations.
+ * \param data
+ * \brief Function data.
+ */
+void calibrate_plugin_worker(ParallelData *data)
+{
+	unsigned int i, j, k, simulation;
+	double e, *value;
+	Calibrate *calibrate;
+	Sampler *sampler;
+#if DEBUG
+printf("calibrate_plugin_worker: start\n");
+#endif
+	calibrate = data->calibrate;
+	sampler = calibrate->sampler;
+	simulation = data->thread;
+	value = calibrate->value + simulation * calibrate->nvariables;
+	g_mutex_lock(&mutex);
+	while (!calibrate->stop && calibrate->nnext < calibrate->nend)
+	{
+		// Proposing a simulation, waiting for the next observation if the
+		// sampler has no proposal while there are pending simulations
+		if (!sampler->propose(sampler->data, value, 1))
+		{
+			if (!sampler->npending) break;
+			g_cond_wait(&cond, &mutex);
+			continue;
+		}
+		for (j = 0; j < calibrate->nvariables; ++j)
+			value[j] = fmin(fmax(value[j], calibrate->rangemin[j]),
+				calibrate->rangemax[j]);
+		++calibrate->nnext;
+		++sampler->npending;
+
+		// Performing the simulation, retrying the transient failures
+		if (calibrate_screen(calibrate, simulation))
+			e = calibrate->penalty * calibrate->nexperiments;
+		else
+		{
+			g_mutex_unlock(&mutex);
+			for (i = 0;; ++i)
+			{
+				e = calibrate_objective(calibrate, simulation, &k);
+				if (k != FAILURE_TRANSIENT) break;
+				g_mutex_lock(&mutex);
+				if (i >= calibrate->retries) ++calibrate->nexhausted;
+				else ++calibrate->nretried;
+				g_mutex_unlock(&mutex);
+				if (i >= calibrate->retries) break;
+			}
+			g_mutex_lock(&mutex);
+			if (calibrate->failure_threshold < 1.)
+				calibrate_observe(calibrate, simulation, k != FAILURE_NONE);
+			calibrate_best(calibrate, simulation, e);
+			calibrate_check(calibrate);
+		}
+		calibrate->error[simulation] = e;
+
+		// Observing the objective function value
+		sampler->observe(sampler->data, value, &e, 1);
+		--sampler->npending;
+		++sampler->nsimulations;
+		sampler->nbatches = (sampler->nsimulations + calibrate->nsimulations
+			- 1) / calibrate->nsimulations;
+		if (calibrate->plugin_state
+			&& !(sampler->nsimulations % calibrate->nsimulations))
+			calibrate_sampler_save(calibrate);
+		g_cond_broadcast(&cond);
+#if DEBUG
+printf("calibrate_plugin_worker: simulation=%u e=%lg\n", simulation, e);
+#endif
+	}
+
+	// Finishing the other threads
+	calibrate->stop = 1;
+	g_cond_broadcast(&cond);
+	g_mutex_unlock(&mutex);
+#if DEBUG
+printf("calibrate_plugin_worker: end\n");
+#endif
+}
+
+/**
+ * \fn void* calibrate_plugin_thread(ParallelData *data)
+ * \brief Function to drive asynchronously the sampler plugin on a GThread.
+ * \param data
+ * \brief Function data.
+ * \return NULL
+ */
+void* calibrate_plugin_thread(ParallelData *data)
+{
+	calibrate_plugin_worker(data);
+	g_thread_exit(NULL);
+	return NULL;
+}
+
+/**
+ * \fn void calibrate_plugin(Calibrate *calibrate)
+ * \brief Function to calibrate with a sampler plugin. On a single task without
+ *   control socket, the sampler is driven asynchronously, a simulation slot
+ *   per thread, up to the batch size by the batches number simulations.
+ *   Otherwise, the sampler proposes the batches of simulations, that are
+ *   performed in parallel, and observes their objective function values when
+ *   the whole batch is performed, and all tasks drive an identical sampler.
+ *   The proposed variable values are clamped to the variable ranges.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_plugin(Calibrate *calibrate)
+{
+	unsigned int i, j, n;
+	double *value;
+	Sampler *sampler;
+	GThread *thread[calibrate->nthreads];
+	ParallelData data[calibrate->nthreads];
+#if DEBUG
+printf("calibrate_plugin: start\n");
+#endif
+	sampler = calibrate->sampler;
+
+	// Adding the restored bests
+	for (i = 0; i < sampler->nsaveds; ++i)
+		calibrate_best_insert(calibrate, sampler->simulation_best[i],
+			sampler->error_best[i],
+			sampler->value_best + i * calibrate->nvariables);
+
+	// Driving asynchronously the sampler
+#ifdef HAVE_MPI
+	if (calibrate->mpi_tasks == 1 && !calibrate->control)
+#else
+	if (!calibrate->control)
+#endif
+	{
+		n = calibrate->nthreads;
+		if (n > calibrate->nsimulations) n = calibrate->nsimulations;
+		calibrate->nnext = sampler->nsimulations;
+		calibrate->nend = calibrate->niterations * calibrate->nsimulations;
+		calibrate->nevaluated = calibrate->stop = calibrate->nstop = 0;
+		sampler->npending = 0;
+		for (i = 0; i < n; ++i)
+		{
+			data[i].calibrate = calibrate;
+			data[i].thread = i;
+		}
+		if (n <= 1) calibrate_plugin_worker(data);
+		else
+		{
+			for (i = 0; i < n; ++i)
+				thread[i] = g_thread_new(NULL, (void(*))calibrate_plugin_thread,
+					&data[i]);
+			for (i = 0; i < n; ++i) g_thread_join(thread[i]);
+		}
+		if (calibrate->plugin_state
+			&& sampler->nsimulations % calibrate->nsimulations)
+			calibrate_sampler_save(calibrate);
+	}
+
+	// Driving the sampler by batches
+	else
+	{
+		while (sampler->nbatches < calibrate->niterations && !calibrate->halt)
+		{
+			// Proposing the batch
+			n = sampler->propose(sampler->data, calibrate->value,
+				calibrate->nsimulations);
+			if (!n) break;
+			if (n > calibrate->nsimulations) n = calibrate->nsimulations;
+			for (i = 0; i < n; ++i)
+				for (j = 0; j < calibrate->nvariables; ++j)
+				{
+					value = calibrate->value + i * calibrate->nvariables + j;
+					*value = fmin(fmax(*value, calibrate->rangemin[j]),
+						calibrate->rangemax[j]);
+				}
+
+			// Performing the simulations
+			calibrate_run(calibrate, 0, n);
+#ifdef HAVE_MPI
+			// Sharing the bests of all tasks
+			for (i = 0; i < n; ++i)
+				if ((i < calibrate->nstart || i >= calibrate->nend)
+					&& !isnan(calibrate->error[i]) && !calibrate->screened[i])
+					calibrate_best(calibrate, i, calibrate->error[i]);
+#endif
+
+			// Observing the objective function values
+			sampler->observe(sampler->data, calibrate->value, calibrate->error,
+				n);
+			++sampler->nbatches;
+			sampler->nsimulations += n;
+			if (calibrate->plugin_state) calibrate_sampler_save(calibrate);
+#if DEBUG
+printf("calibrate_plugin: batch=%u simulations=%u\n", sampler->nbatches, n);
+#endif
+		}
+	}
+
+#ifdef HAVE_MPI
+	// The bests of every task are the bests of all tasks
+	if (calibrate->mpi_rank) calibrate->nsaveds = 0;
+	if (!calibrate->mpi_rank)
+#endif
+	printf("plugin batches=%u simulations=%u\n", sampler->nbatches,
+		sampler->nsimulations);
+#if DEBUG
+printf("calibrate_plugin: end\n");
+#endif
+}
+
+/**
+ * \fn void calibrate_merge(Calibrate *calibrate, unsigned int nsaveds, \
+ *   unsigned int *simulation_best, double *error_best, double *value_best)
+ * \brief Function to merge the bests simulations of other task.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param nsaveds
+ * \brief Number of saved simulations of the other task.
+ * \param simulation_best
+ * \brief Array of best simulation numbers of the other task.
+ * \param error_best
+ * \brief Array of best minimum errors of the other task.
+ * \param value_best
+ * \brief Array of best variable values of the other task.
+ */
+void calibrate_merge(Calibrate *calibrate, unsigned int nsaveds,
+	unsigned int *simulation_best, double *error_best, double *value_best)
+{
+	unsigned int i;
+	for (i = 0; i < nsaveds; ++i)
+		calibrate_best_insert(calibrate, simulation_best[i], error_best[i],
+			value_best + i * calibrate->nvariables);
+}
+
+/**
+ * \fn void results_header(FILE *file, unsigned int nvariables, \
+ *   unsigned int nbests, char **format)
+ * \brief Function to write the header of a results file.
+ * \param file
+ * \brief Results file.
+ * \param nvariables
+ * \brief Variables number.
+ * \param nbests
+ * \brief Bests number.
+ * \param format
+ * \brief Array of c-string formats of the variables.
+ */
+void results_header(FILE *file, unsigned int nvariables, unsigned int nbests,
+	char **format)
+{
+	unsigned int i, j;
+	fwrite(&nvariables, sizeof(unsigned int), 1, file);
+	fwrite(&nbests, sizeof(unsigned int), 1, file);
+	for (i = 0; i < nvariables; ++i)
+	{
+		j = strlen(format[i]);
+		fwrite(&j, sizeof(unsigned int), 1, file);
+		fwrite(format[i], sizeof(char), j, file);
+	}
+}
+
+/**
+ * \fn int results_open(ResultsFile *results, char *filename)
+ * \brief Function to open a results file and to read its header.
+ * \param results
+ * \brief Results file data pointer.
+ * \param filename
+ * \brief Results file name.
+ * \return 1 on success, 0 on error.
+ */
+int results_open(ResultsFile *results, char *filename)
+{
+	unsigned int i, j;
+	results->format = NULL;
+	results->value = NULL;
+	results->nvariables = 0;
+	results->file = fopen(filename, "rb");
+	if (!results->file
+		|| fread(&i, sizeof(unsigned int), 1, results->file) != 1
+		|| fread(&results->nbests, sizeof(unsigned int), 1, results->file) != 1)
+		return 0;
+	results->format = (char**)malloc(i * sizeof(char*));
+	results->value = (double*)malloc(i * sizeof(double));
+	for (; results->nvariables < i; ++results->nvariables)
+	{
+		if (fread(&j, sizeof(unsigned int), 1, results->file) != 1) return 0;
+		results->format[results->nvariables] = (char*)malloc(j + 1);
+		if (fread(results->format[results->nvariables], sizeof(char), j,
+			results->file) != j)
+		{
+			free(results->format[results->nvariables]);
+			return 0;
+		}
+		results->format[results->nvariables][j] = 0;
+	}
+	return 1;
+}
+
+/**
+ * \fn void results_close(ResultsFile *results)
+ * \brief Function to close a results file and to free its memory.
+ * \param results
+ * \brief Results file data pointer.
+ */
+void results_close(ResultsFile *results)
+{
+	unsigned int i;
+	if (results->file) fclose(results->file);
+	for (i = 0; i < results->nvariables; ++i) free(results->format[i]);
+	free(results->format);
+	free(results->value);
+}
+
+/**
+ * \fn int results_read(ResultsFile *results)
+ * \brief Function to read the next simulation of a results file.
+ * \param results
+ * \brief Results file data pointer.
+ * \return 1 on success, 0 at the end of the file.
+ */
+int results_read(ResultsFile *results)
+{
+	return fread(&results->simulation, sizeof(unsigned int), 1, results->file)
+		== 1 && fread(&results->error, sizeof(double), 1, results->file) == 1
+		&& fread(results->value, sizeof(double), results->nvariables,
+		results->file) == results->nvariables;
+}
+
+/**
+ * \fn int results_lower(ResultsFile *a, ResultsFile *b)
+ * \brief Function to compare the current simulations of two results files.
+ * \param a
+ * \brief First results file data pointer.
+ * \param b
+ * \brief Second results file data pointer.
+ * \return 1 if the simulation of the first file goes before, 0 otherwise.
+ */
+int results_lower(ResultsFile *a, ResultsFile *b)
+{
+	if (a->error != b->error) return a->error < b->error;
+	return a->simulation < b->simulation;
+}
+
+/**
+ * \fn void results_sift(ResultsFile **heap, unsigned int n, unsigned int i)
+ * \brief Function to move down an element of a binary heap of results files.
+ * \param heap
+ * \brief Heap array of results file data pointers.
+ * \param n
+ * \brief Heap size.
+ * \param i
+ * \brief Element position.
+ */
+void results_sift(ResultsFile **heap, unsigned int n, unsigned int i)
+{
+	unsigned int j;
+	ResultsFile *r;
+	for (;;)
+	{
+		j = 2 * i + 1;
+		if (j >= n) break;
+		if (j + 1 < n && results_lower(heap[j + 1], heap[j])) ++j;
+		if (!results_lower(heap[j], heap[i])) break;
+		r = heap[i];
+		heap[i] = heap[j];
+		heap[j] = r;
+		i = j;
+	}
+}
+
+/**
+ * \fn int results_merge(char *output, unsigned int nfiles, char **filename)
+ * \brief Function to merge the results files of independent shards in a
+ *   single sorted results file and to show the best simulation and the bests
+ *   number of the header merged simulations. Only the current simulation of
+ *   every file is held in memory.
+ * \param output
+ * \brief Merged results file name.
+ * \param nfiles
+ * \brief Number of results files to merge.
+ * \param filename
+ * \brief Array of results file names.
+ * \return 1 on success, 0 on error.
+ */
+int results_merge(char *output, unsigned int nfiles, char **filename)
+{
+	unsigned int i, j, n, nsimulations;
+	char buffer[512];
+	ResultsFile *results, **heap;
+	FILE *file;
+#if DEBUG
+printf("results_merge: start\n");
+#endif
+
+	// Opening the results files and checking the headers
+	results = (ResultsFile*)malloc(nfiles * sizeof(ResultsFile));
+	heap = (ResultsFile**)malloc(nfiles * sizeof(ResultsFile*));
+	file = NULL;
+	for (i = n = 0; i < nfiles; ++i)
+	{
+		if (!results_open(results + i, filename[i])
+			|| results[i].nvariables != results[0].nvariables
+			|| results[i].nbests != results[0].nbests)
+		{
+			printf("Bad results file %s\n", filename[i]);
+			++i;
+			break;
+		}
+		if (results_read(results + i)) heap[n++] = results + i;
+	}
+	if (i == nfiles)
+	{
+		file = fopen(output, "wb");
+		if (!file) printf("Unable to open the results file %s\n", output);
+	}
+
+	// Merging the results
+	if (file)
+	{
+		results_header(file, results->nvariables, results->nbests,
+			results->format);
+		for (j = n / 2; j-- > 0;) results_sift(heap, n, j);
+		for (nsimulations = 0; n; ++nsimulations)
+		{
+			fwrite(&heap[0]->simulation, sizeof(unsigned int), 1, file);
+			fwrite(&heap[0]->error, sizeof(double), 1, file);
+			fwrite(heap[0]->value, sizeof(double), results->nvariables, file);
+
+			// Best choice
+			if (!nsimulations)
+			{
+				printf("THE BEST IS\n");
+				printf("error=%le\n", heap[0]->error);
+				for (j = 0; j < results->nvariables; ++j)
+				{
+					snprintf(buffer, 512, "parameter%%u=%s\n",
+						results->format[j]);
+					printf(buffer, j, heap[0]->value[j]);
+				}
+			}
+
+			// Bests
+			if (nsimulations < results->nbests)
+			{
+				printf("best=%u simulation=%u error=%le", nsimulations + 1,
+					heap[0]->simulation, heap[0]->error);
+				for (j = 0; j < results->nvariables; ++j)
+				{
+					snprintf(buffer, 512, " parameter%%u=%s",
+						results->format[j]);
+					printf(buffer, j, heap[0]->value[j]);
+				}
+				printf("\n");
+			}
+
+			if (!results_read(heap[0])) heap[0] = heap[--n];
+			results_sift(heap, n, 0);
+		}
+		fclose(file);
+		printf("merged simulations=%u\n", nsimulations);
+	}
+
+	// Freeing memory
+	for (j = 0; j < i; ++j) results_close(results + j);
+	free(heap);
+	free(results);
+#if DEBUG
+printf("results_merge: end\n");
+#endif
+	return file != NULL;
+}
+
+/**
+ * \fn int calibrate_result_compare(const void *a, const void *b)
+ * \brief Function to compare two simulation results to sort them with qsort
+ *   by objective function value and simulation number.
+ * \param a
+ * \brief Pointer to the first result.
+ * \param b
+ * \brief Pointer to the second result.
+ * \return -1 if the first result is lower, 1 if it is greater, 0 otherwise.
+ */
+int calibrate_result_compare(const void *a, const void *b)
+{
+	Result *x, *y;
+	x = (Result*)a;
+	y = (Result*)b;
+	if (x->error != y->error)
+		return (x->error > y->error) - (x->error < y->error);
+	return (x->simulation > y->simulation) - (x->simulation < y->simulation);
+}
+
+/**
+ * \fn void calibrate_results(Calibrate *calibrate)
+ * \brief Function to save the sorted results of the performed simulations in
+ *   a binary file. The file header is the variables number, the bests number
+ *   and the length and the c-string format of every variable. Then, sorted by
+ *   objective function value and simulation number, every simulation is saved
+ *   as the simulation number, the objective function value and the variable
+ *   values.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_results(Calibrate *calibrate)
+{
+	unsigned int i, j;
+	Result *result;
+	FILE *file;
+#if DEBUG
+printf("calibrate_results: start\n");
+#endif
+
+	// Sorting the performed simulations
+	result = (Result*)malloc(calibrate->nsimulations * sizeof(Result));
+	for (i = j = 0; i < calibrate->nsimulations; ++i)
+		if (!isnan(calibrate->error[i]))
+		{
+			result[j].error = calibrate->error[i];
+			result[j].simulation = i;
+			++j;
+		}
+	qsort(result, j, sizeof(Result), calibrate_result_compare);
+
+	// Saving the results
+	file = fopen(calibrate->results, "wb");
+	if (!file)
+	{
+		printf("Unable to open the results file %s\n", calibrate->results);
+		free(result);
+		return;
+	}
+	results_header(file, calibrate->nvariables, calibrate->nbests,
+		calibrate->format);
+	for (i = 0; i < j; ++i)
+	{
+		fwrite(&result[i].simulation, sizeof(unsigned int), 1, file);
+		fwrite(&result[i].error, sizeof(double), 1, file);
+		fwrite(calibrate->value + result[i].simulation * calibrate->nvariables,
+			sizeof(double), calibrate->nvariables, file);
+	}
+	fclose(file);
+	free(result);
+
+#if DEBUG
+printf("calibrate_results: end\n");
+#endif
+}
+
+/**
+ * \fn char* calibrate_hash(Calibrate *calibrate, unsigned int experiment)
+ * \brief Function to get the identity of an experiment: the checksum of the
+ *   experimental data file and the templates.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param experiment
+ * \brief Experiment number.
+ * \return Checksum string (freed with g_free).
+ */
+char* calibrate_hash(Calibrate *calibrate, unsigned int experiment)
+{
+	unsigned int j;
+	char *hash;
+	GChecksum *checksum;
+	GMappedFile *file;
+	checksum = g_checksum_new(G_CHECKSUM_SHA256);
+	file = g_mapped_file_new(calibrate->experiment[experiment], 0, NULL);
+	if (file)
+	{
+		g_checksum_update(checksum,
+			(unsigned char*)g_mapped_file_get_contents(file),
+			g_mapped_file_get_length(file));
+		g_mapped_file_unref(file);
+	}
+	else
+		g_checksum_update(checksum,
+			(unsigned char*)calibrate->experiment[experiment], -1);
+	for (j = 0; j < calibrate->ninputs; ++j)
+		if (calibrate->file[j][experiment])
+			g_checksum_update(checksum,
+				(unsigned char*)
+				g_mapped_file_get_contents(calibrate->file[j][experiment]),
+				g_mapped_file_get_length(calibrate->file[j][experiment]));
+	hash = g_strdup(g_checksum_get_string(checksum));
+	g_checksum_free(checksum);
+	return hash;
+}
+
+/**
+ * \fn int calibrate_store_open(Calibrate *calibrate)
+ * \brief Function to read the stored objective function values and to open
+ *   the store file to add the new values. Every line of the store file is the
+ *   experiment identity, the objective function value and the variable values.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \return 1 on success, 0 on error.
+ */
+int calibrate_store_open(Calibrate *calibrate)
+{
+	unsigned int i;
+	int k;
+	double e, *stored;
+	char hash[80], buffer[calibrate->nvariables * VALUE_LENGTH + 160];
+	FILE *file;
+#if DEBUG
+printf("calibrate_store_open: start\n");
+#endif
+
+	// Experiment identities
+	calibrate->hash = (char**)malloc(calibrate->nexperiments * sizeof(char*));
+	for (i = 0; i < calibrate->nexperiments; ++i)
+		calibrate->hash[i] = calibrate_hash(calibrate, i);
+
+	// Reading the stored values
+	calibrate->stored
+		= g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	file = fopen(calibrate->store, "r");
+	if (file)
+	{
+		while (fgets(buffer, sizeof(buffer), file))
+		{
+			if (sscanf(buffer, "%79s %le %n", hash, &e, &k) < 2) continue;
+			buffer[strcspn(buffer, "\n")] = 0;
+			stored = g_new(double, 1);
+			*stored = e;
+			g_hash_table_insert(calibrate->stored,
+				g_strdup_printf("%s %s", hash, buffer + k), stored);
+		}
+		fclose(file);
+	}
+
+	// Opening the store to add the new values
+	calibrate->file_store = fopen(calibrate->store, "a");
+	if (!calibrate->file_store)
+	{
+		printf("Unable to open the store file %s\n", calibrate->store);
+		return 0;
+	}
+	calibrate->nreused = calibrate->nstored = 0;
+#if DEBUG
+printf("calibrate_store_open: end\n");
+#endif
+	return 1;
+}
+
+/**
+ * \fn void calibrate_budget(Calibrate *calibrate)
+ * \brief Function to evaluate the previous candidates of the store on the
+ *   current experiments. The candidates with the most stored experiments are
+ *   sorted by the sum of their stored objective function values and the
+ *   budget bests are simulated, only on the not stored experiments.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_budget(Calibrate *calibrate)
+{
+	unsigned int i, j, n, nmax, ncandidates;
+	int k;
+	double e, *sum;
+	unsigned int *count;
+	char hash[80], buffer[calibrate->nvariables * VALUE_LENGTH + 160], *c,
+		**candidate;
+	Result *result;
+	GHashTable *table;
+	FILE *file;
+#if DEBUG
+printf("calibrate_budget: start\n");
+#endif
+
+	// Adding the stored values of every candidate on the current experiments
+	ncandidates = 0;
+	candidate = NULL;
+	sum = NULL;
+	count = NULL;
+	table = g_hash_table_new(g_str_hash, g_str_equal);
+	file = fopen(calibrate->store, "r");
+	if (file)
+	{
+		while (fgets(buffer, sizeof(buffer), file))
+		{
+			if (sscanf(buffer, "%79s %le %n", hash, &e, &k) < 2) continue;
+			for (j = 0; j < calibrate->nexperiments
+				&& strcmp(hash, calibrate->hash[j]); ++j);
+			if (j == calibrate->nexperiments) continue;
+			buffer[strcspn(buffer, "\n")] = 0;
+			i = GPOINTER_TO_UINT(g_hash_table_lookup(table, buffer + k));
+			if (!i)
+			{
+				candidate = (char**)realloc(candidate,
+					(ncandidates + 1) * sizeof(char*));
+				sum = (double*)realloc(sum, (ncandidates + 1) * sizeof(double));
+				count = (unsigned int*)realloc(count,
+					(ncandidates + 1) * sizeof(unsigned int));
+				candidate[ncandidates] = strdup(buffer + k);
+				sum[ncandidates] = 0.;
+				count[ncandidates] = 0;
+				i = ++ncandidates;
+				g_hash_table_insert(table, candidate[i - 1],
+					GUINT_TO_POINTER(i));
+			}
+			sum[i - 1] += e;
+			++count[i - 1];
+		}
+		fclose(file);
+	}
+	g_hash_table_destroy(table);
+
+	// Sorting the candidates with the most stored experiments
+	for (i = nmax = 0; i < ncandidates; ++i)
+		if (count[i] > nmax) nmax = count[i];
+	result = (Result*)malloc(ncandidates * sizeof(Result));
+	for (i = n = 0; i < ncandidates; ++i)
+		if (count[i] == nmax)
+		{
+			result[n].error = sum[i];
+			result[n].simulation = i;
+			++n;
+		}
+	qsort(result, n, sizeof(Result), calibrate_result_compare);
+	if (n > calibrate->budget) n = calibrate->budget;
+
+	// Simulating the best candidates
+	for (i = 0; i < n; ++i)
+	{
+		c = candidate[result[i].simulation];
+		for (j = 0; j < calibrate->nvariables; ++j)
+			calibrate->value[i * calibrate->nvariables + j] = strtod(c, &c);
+	}
+#ifdef HAVE_MPI
+	if (!calibrate->mpi_rank)
+#endif
+	printf("budget candidates=%u stored experiments=%u\n", n, nmax);
+#ifdef HAVE_MPI
+	// Reading the store on all tasks before adding new values
+	MPI_Barrier(calibrate->mpi_comm);
+#endif
+	calibrate_run(calibrate, 0, n);
+
+	// Freeing memory
+	for (i = 0; i < ncandidates; ++i) free(candidate[i]);
+	free(candidate);
+	free(sum);
+	free(count);
+	free(result);
+#if DEBUG
+printf("calibrate_budget: end\n");
+#endif
+}
+
+/**
+ * \fn int calibrate_control_open(Calibrate *calibrate)
+ * \brief Function to open the control socket and the steering log, and to
+ *   start the control thread. With MPI, only the master task is steered.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \return 1 on success, 0 on error.
+ */
+int calibrate_control_open(Calibrate *calibrate)
+{
+	unsigned int j;
+	struct sockaddr_un address;
+#if DEBUG
+printf("calibrate_control_open: start\n");
+#endif
+	calibrate->bound_min = (double*)malloc(4 * calibrate->nvariables
+		* sizeof(double));
+	calibrate->bound_max = calibrate->bound_min + calibrate->nvariables;
+	calibrate->priority_min = calibrate->bound_max + calibrate->nvariables;
+	calibrate->priority_max = calibrate->priority_min + calibrate->nvariables;
+	for (j = 0; j < calibrate->nvariables; ++j)
+	{
+		calibrate->bound_min[j] = calibrate->priority_min[j] = -INFINITY;
+		calibrate->bound_max[j] = calibrate->priority_max[j] = INFINITY;
+	}
+	calibrate->command = NULL;
+	calibrate->nactive = calibrate->nthreads;
+	calibrate->paused = calibrate->control_end = calibrate->ncancelled = 0;
+	calibrate->file_control = NULL;
+	calibrate->thread_control = NULL;
+#ifdef HAVE_MPI
+	if (calibrate->mpi_rank) return 1;
+#endif
+
+	// Opening the socket
+	if (strlen(calibrate->control) >= sizeof(address.sun_path))
+	{
+		printf("Too long control socket name\n");
+		return 0;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, calibrate->control);
+	unlink(calibrate->control);
+	calibrate->control_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (calibrate->control_socket < 0
+		|| bind(calibrate->control_socket, (struct sockaddr*)&address,
+		sizeof(address))
+		|| listen(calibrate->control_socket, 1))
+	{
+		printf("Unable to open the control socket %s\n", calibrate->control);
+		return 0;
+	}
+
+	// Opening the log
+	calibrate->file_control = fopen(calibrate->control_log, "w");
+	if (!calibrate->file_control)
+	{
+		printf("Unable to open the steering log %s\n", calibrate->control_log);
+		return 0;
+	}
+
+	// Starting the control thread
+	calibrate->thread_control
+		= g_thread_new(NULL, (void(*))calibrate_control, calibrate);
+#if DEBUG
+printf("calibrate_control_open: end\n");
+#endif
+	return 1;
+}
+
+/**
+ * \fn void calibrate_control_close(Calibrate *calibrate)
+ * \brief Function to stop the control thread and to close the control socket
+ *   and the steering log.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_control_close(Calibrate *calibrate)
+{
+#if DEBUG
+printf("calibrate_control_close: start\n");
+#endif
+	if (calibrate->thread_control)
+	{
+		g_mutex_lock(&mutex);
+		calibrate->control_end = 1;
+		g_mutex_unlock(&mutex);
+		g_thread_join(calibrate->thread_control);
+		close(calibrate->control_socket);
+		unlink(calibrate->control);
+		fclose(calibrate->file_control);
+	}
+	free(calibrate->command);
+	free(calibrate->bound_min);
+#if DEBUG
+printf("calibrate_control_close: end\n");
+#endif
+}
+
+/**
+ * \fn int calibrate_sampler_open(Calibrate *calibrate)
+ * \brief Function to load the sampler plugin, to create the sampler and to
+ *   restore its saved state, with the observed batches and the bests.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \return 1 on success, 0 on error.
+ */
+int calibrate_sampler_open(Calibrate *calibrate)
+{
+	unsigned int i;
+	int k;
+	FILE *file;
+	Sampler *sampler;
+	const char *symbol[7] = {"sampler_abi", "sampler_new", "sampler_propose",
+		"sampler_observe", "sampler_save", "sampler_restore", "sampler_free"};
+	gpointer *function[7];
+#if DEBUG
+printf("calibrate_sampler_open: start\n");
+#endif
+	sampler = calibrate->sampler = (Sampler*)g_malloc0(sizeof(Sampler));
+
+	// Loading the plugin functions
+	sampler->module = g_module_open(calibrate->library, G_MODULE_BIND_LAZY);
+	if (!sampler->module)
+	{
+		printf("Unable to open the plugin %s: %s\n", calibrate->library,
+			g_module_error());
+		return 0;
+	}
+	function[0] = (gpointer*)&sampler->abi;
+	function[1] = (gpointer*)&sampler->new;
+	function[2] = (gpointer*)&sampler->propose;
+	function[3] = (gpointer*)&sampler->observe;
+	function[4] = (gpointer*)&sampler->save;
+	function[5] = (gpointer*)&sampler->restore;
+	function[6] = (gpointer*)&sampler->free;
+	for (i = 0; i < 7; ++i)
+		if (!g_module_symbol(sampler->module, symbol[i], function[i]))
+		{
+			printf("No %s function in the plugin %s\n", symbol[i],
+				calibrate->library);
+			return 0;
+		}
+	if (sampler->abi() != SAMPLER_ABI)
+	{
+		printf("Bad interface version of the plugin %s\n", calibrate->library);
+		return 0;
+	}
+
+	// Creating the sampler
+	sampler->info.nvariables = calibrate->nvariables;
+	sampler->info.nsimulations = calibrate->nsimulations;
+	sampler->info.niterations = calibrate->niterations;
+	sampler->info.seed = RANDOM_SEED;
+	sampler->info.label = (const char**)calibrate->label;
+	sampler->info.rangemin = calibrate->rangemin;
+	sampler->info.rangemax = calibrate->rangemax;
+	sampler->info.parameters
+		= calibrate->plugin_parameters ? calibrate->plugin_parameters : "";
+	sampler->data = sampler->new(&sampler->info);
+	if (!sampler->data)
+	{
+		printf("Unable to create the sampler of the plugin %s\n",
+			calibrate->library);
+		return 0;
+	}
+
+	// Restoring the saved state
+	if (calibrate->plugin_state && !access(calibrate->plugin_state, F_OK))
+	{
+		file = fopen(calibrate->plugin_state, "rb");
+		k = file
+			&& fread(&sampler->nbatches, sizeof(unsigned int), 1, file) == 1
+			&& fread(&sampler->nsimulations, sizeof(unsigned int), 1, file) == 1
+			&& fread(&sampler->nsaveds, sizeof(unsigned int), 1, file) == 1
+			&& sampler->nsaveds <= calibrate->nbests;
+		if (k)
+		{
+			i = sampler->nsaveds;
+			sampler->simulation_best
+				= (unsigned int*)malloc(i * sizeof(unsigned int));
+			sampler->error_best = (double*)malloc(i * sizeof(double));
+			sampler->value_best
+				= (double*)malloc(i * calibrate->nvariables * sizeof(double));
+			k = fread(sampler->simulation_best, sizeof(unsigned int), i, file)
+				== i
+				&& fread(sampler->error_best, sizeof(double), i, file) == i
+				&& fread(sampler->value_best, sizeof(double),
+					i * calibrate->nvariables, file)
+					== i * calibrate->nvariables
+				&& sampler->restore(sampler->data, file);
+		}
+		if (file) fclose(file);
+		if (!k)
+		{
+			printf("Unable to restore the sampler state %s\n",
+				calibrate->plugin_state);
+			return 0;
+		}
+	}
+#if DEBUG
+printf("calibrate_sampler_open: end\n");
+#endif
+	return 1;
+}
+
+/**
+ * \fn void calibrate_sampler_close(Calibrate *calibrate)
+ * \brief Function to free the sampler and to unload the sampler plugin.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ */
+void calibrate_sampler_close(Calibrate *calibrate)
+{
+	Sampler *sampler;
+	sampler = calibrate->sampler;
+	if (sampler->data) sampler->free(sampler->data);
+	if (sampler->module) g_module_close(sampler->module);
+	free(sampler->value_best);
+	free(sampler->error_best);
+	free(sampler->simulation_best);
+	g_free(sampler);
+	calibrate->sampler = NULL;
+}
+
+/**
+ * \fn int calibrate_variable(Calibrate *calibrate, xmlNode *node)
+ * \brief Function to read the data of a variable.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param node
+ * \brief XML node of the variable.
+ * \return 1 on success, 0 on error.
+ */
+int calibrate_variable(Calibrate *calibrate, xmlNode *node)
+{
+	xmlChar *buffer;
+#if DEBUG
+printf("calibrate_variable: start\n");
+#endif
+	if (xmlStrcmp(node->name, XML_VARIABLE))
+	{
+		printf("Bad XML node\n");
+		return 0;
+	}
+	if (xmlHasProp(node, XML_NAME))
+	{
+		calibrate->label = realloc(calibrate->label,
+			(1 + calibrate->nvariables) * sizeof(char*));
+		calibrate->label[calibrate->nvariables] =
+			(char*)xmlGetProp(node, XML_NAME);
+	}
+	else
+	{
+		printf("No variable %u name\n", calibrate->nvariables + 1);
+		return 0;
+	}
+	if (xmlHasProp(node, XML_MINIMUM))
+	{
+		calibrate->rangemin = realloc(calibrate->rangemin,
+			(1 + calibrate->nvariables) * sizeof(double));
+		buffer = xmlGetProp(node, XML_MINIMUM);
+		calibrate->rangemin[calibrate->nvariables] = atof((char*)buffer);
+		xmlFree(buffer);
+	}
+	else
+	{
+		printf("No variable %u minimum range\n", calibrate->nvariables + 1);
+		return 0;
+	}
+	if (xmlHasProp(node, XML_MAXIMUM))
+	{
+		calibrate->rangemax = realloc(calibrate->rangemax,
+			(1 + calibrate->nvariables) * sizeof(double));
+		buffer = xmlGetProp(node, XML_MAXIMUM);
+		calibrate->rangemax[calibrate->nvariables] = atof((char*)buffer);
+		xmlFree(buffer);
+	}
+	else
+	{
+		printf("No variable %u maximum range\n", calibrate->nvariables + 1);
+		return 0;
+	}
+	calibrate->format = realloc(calibrate->format,
+		(1 + calibrate->nvariables) * sizeof(char*));
+	if (xmlHasProp(node, XML_FORMAT))
+	{
+		calibrate->format[calibrate->nvariables] =
+			(char*)xmlGetProp(node, XML_FORMAT);
+	}
+	else
+	{
+		calibrate->format[calibrate->nvariables] =
+			(char*)xmlStrdup(DEFAULT_FORMAT);
+	}
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_SWEEP)
+	{
+		if (xmlHasProp(node, XML_SWEEPS))
+		{
+			calibrate->nsweeps = realloc(calibrate->nsweeps,
+				(1 + calibrate->nvariables) * sizeof(unsigned int));
+			buffer = xmlGetProp(node, XML_SWEEPS);
+			calibrate->nsweeps[calibrate->nvariables] =
+				strtoul((char*)buffer, NULL, 0);
+			xmlFree(buffer);
+		}
+		else
+		{
+			printf("No variable %u sweeps number\n",
+				calibrate->nvariables + 1);
+			return 0;
+		}
+		calibrate->nsimulations *=
+			calibrate->nsweeps[calibrate->nvariables];
+#if DEBUG
+printf("calibrate_variable: nsweeps=%u nsimulations=%u\n",
+calibrate->nsweeps[calibrate->nvariables], calibrate->nsimulations);
+#endif
+	}
+	else if (calibrate->algorithm == CALIBRATE_ALGORITHM_BLOCK_COORDINATE)
+	{
+		// Optional sweeps, 0 to sample by Monte-Carlo
+		calibrate->nsweeps = realloc(calibrate->nsweeps,
+			(1 + calibrate->nvariables) * sizeof(unsigned int));
+		calibrate->nsweeps[calibrate->nvariables] = 0;
+		if (xmlHasProp(node, XML_SWEEPS))
+		{
+			buffer = xmlGetProp(node, XML_SWEEPS);
+			calibrate->nsweeps[calibrate->nvariables] =
+				strtoul((char*)buffer, NULL, 0);
+			xmlFree(buffer);
+		}
+	}
+	++calibrate->nvariables;
+#if DEBUG
+printf("calibrate_variable: end\n");
+#endif
+	return 1;
+}
+
+/**
+ * \fn int calibrate_new(Calibrate *calibrate, char *filename)
+ * \brief Function to open and perform a calibration.
+ * \param calibrate
+ * \brief Calibration data pointer.
+ * \param filename
+ * \brief Input data file name.
+ * \return 1 on success, 0 on error.
+ */
+int calibrate_new(Calibrate *calibrate, char *filename)
+{
+	unsigned int i, j;
+	char buffer2[512], *c, *c2;
+	xmlChar *buffer;
+	xmlNode *node, *child, *variable;
+	xmlDoc *doc;
+#if HAVE_MPI
+	int k;
+	unsigned int nsaveds, *simulation_best, nfailures[FAILURES];
+	double e, *error_best, *value_best;
+	MPI_Status mpi_stat;
+#endif
+	static const xmlChar *template[4]=
+		{XML_TEMPLATE1, XML_TEMPLATE2, XML_TEMPLATE3, XML_TEMPLATE4};
+
+#if DEBUG
+printf("calibrate_new: start\n");
+#endif
+
+	// Parsing the XML data file
+	doc = xmlParseFile(filename);
+	if (!doc)
+	{
+		printf("Unable to parse the data file %s\n", filename);
+		return 0;
+	}
+
+	// Obtaining the root XML node
+	node = xmlDocGetRootElement(doc);
+	if (!node)
+	{
+		printf("No XML nodes in the data file\n");
+		return 0;
+	}
+	if (xmlStrcmp(node->name, XML_CALIBRATE))
+	{
+		printf("Bad name of the XML root node in the data file\n");
+		return 0;
+	}
+
+	// Obtaining the simulator file
+	if (xmlHasProp(node, XML_SIMULATOR))
+	{
+		calibrate->simulator = (char*)xmlGetProp(node, XML_SIMULATOR);
+	}
+	else
+	{
+		printf("No simulator in the data file\n");
+		return 0;
+	}
+
+	// Obtaining the evaluator file
+	if (xmlHasProp(node, XML_EVALUATOR))
+	{
+		calibrate->evaluator = (char*)xmlGetProp(node, XML_EVALUATOR);
+	}
+	else
+	{
+		printf("No error in the data file\n");
+		return 0;
+	}
+
+	// Reading the algorithm
+	if (xmlHasProp(node, XML_ALGORITHM))
+	{
+		buffer = xmlGetProp(node, XML_ALGORITHM);
+		if (!xmlStrcmp(buffer, XML_SWEEP))
+		{
+			calibrate->algorithm = CALIBRATE_ALGORITHM_SWEEP;
+		}
+		else if (!xmlStrcmp(buffer, XML_MONTE_CARLO))
+		{
+			calibrate->algorithm = CALIBRATE_ALGORITHM_MONTE_CARLO;
+		}
+		else if (!xmlStrcmp(buffer, XML_MCMC))
+		{
+			calibrate->algorithm = CALIBRATE_ALGORITHM_MCMC;
+		}
+		else if (!xmlStrcmp(buffer, XML_ABC_SMC))
+		{
+			calibrate->algorithm = CALIBRATE_ALGORITHM_ABC_SMC;
+		}
+		else if (!xmlStrcmp(buffer, XML_SOBOL_INDICES))
+		{
+			calibrate->algorithm = CALIBRATE_ALGORITHM_SOBOL;
+		}
+		else if (!xmlStrcmp(buffer, XML_PORTFOLIO))
+		{
+			calibrate->algorithm = CALIBRATE_ALGORITHM_PORTFOLIO;
+		}
+		else if (!xmlStrcmp(buffer, XML_BLOCK_COORDINATE))
+		{
+			calibrate->algorithm = CALIBRATE_ALGORITHM_BLOCK_COORDINATE;
+		}
+		else if (!xmlStrcmp(buffer, XML_PLUGIN))
+		{
+			calibrate->algorithm = CALIBRATE_ALGORITHM_PLUGIN;
+		}
+		else
+		{
+			calibrate->algorithm = CALIBRATE_ALGORITHM_GENETIC;
+		}
+		xmlFree(buffer);
+	}
+	else calibrate->algorithm = CALIBRATE_ALGORITHM_MONTE_CARLO;
+
+	// Reading the sampler plugin data
+	calibrate->library = calibrate->plugin_parameters = calibrate->plugin_state
+		= NULL;
+	calibrate->sampler = NULL;
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_PLUGIN)
+	{
+		if (!xmlHasProp(node, XML_LIBRARY))
+		{
+			printf("No plugin library in the data file\n");
+			return 0;
+		}
+		calibrate->library = (char*)xmlGetProp(node, XML_LIBRARY);
+		if (xmlHasProp(node, XML_PLUGIN_PARAMETERS))
+			calibrate->plugin_parameters
+				= (char*)xmlGetProp(node, XML_PLUGIN_PARAMETERS);
+		if (xmlHasProp(node, XML_PLUGIN_STATE))
+			calibrate->plugin_state = (char*)xmlGetProp(node, XML_PLUGIN_STATE);
+	}
+
+	// Obtaining the simulations number
+	if (calibrate->algorithm != CALIBRATE_ALGORITHM_SWEEP)
+	{
+		if (xmlHasProp(node, XML_SIMULATIONS))
+		{
+			buffer = xmlGetProp(node, XML_SIMULATIONS);
+			calibrate->nsimulations = strtoul((char*)buffer, NULL, 0);
+			xmlFree(buffer);
+		}
+		else if (calibrate->algorithm == CALIBRATE_ALGORITHM_BLOCK_COORDINATE)
+			calibrate->nsimulations = 0;
+		else
+		{
+			printf("No simulations number in the data file\n");
+			return 0;
+		}
+	}
+
+	// Reading the algorithm tolerance
+	if (xmlHasProp(node, XML_TOLERANCE))
+	{
+		buffer = xmlGetProp(node, XML_TOLERANCE);
+		calibrate->tolerance = atof((char*)buffer);
+		xmlFree(buffer);
+	}
+	else calibrate->tolerance = 0.;
+
+	// Reading the Monte-Carlo stopping rule
+	calibrate->stop_probability = 0.;
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_MONTE_CARLO
+		&& xmlHasProp(node, XML_STOP_PROBABILITY))
+	{
+		buffer = xmlGetProp(node, XML_STOP_PROBABILITY);
+		calibrate->stop_probability = atof((char*)buffer);
+		xmlFree(buffer);
+		if (calibrate->stop_probability < 0.
+			|| calibrate->stop_probability >= 1.)
+		{
+			printf("Bad stop probability in the data file\n");
+			return 0;
+		}
+	}
+
+	// Reading the sorted results file
+	calibrate->results = NULL;
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_MONTE_CARLO
+		|| calibrate->algorithm == CALIBRATE_ALGORITHM_SWEEP)
+	{
+		if (xmlHasProp(node, XML_RESULTS))
+			calibrate->results = (char*)xmlGetProp(node, XML_RESULTS);
+		else if (calibrate->nshards > 1)
+			calibrate->results = (char*)xmlStrdup(DEFAULT_RESULTS);
+		if (calibrate->nshards > 1)
+		{
+			snprintf(buffer2, 512, "%s.%u", calibrate->results,
+				calibrate->shard);
+			xmlFree(calibrate->results);
+			calibrate->results = (char*)xmlStrdup((xmlChar*)buffer2);
+		}
+	}
+	else if (calibrate->nshards > 1)
+	{
+		printf("Shards are only available with sweep or Monte-Carlo\n");
+		return 0;
+	}
+
+	// Reading the shard mode
+	calibrate->shard_mode = SHARD_MODE_INTERLEAVED;
+	if (xmlHasProp(node, XML_SHARD))
+	{
+		buffer = xmlGetProp(node, XML_SHARD);
+		if (!xmlStrcmp(buffer, XML_BLOCKED))
+			calibrate->shard_mode = SHARD_MODE_BLOCKED;
+		else if (xmlStrcmp(buffer, XML_INTERLEAVED))
+		{
+			printf("Bad shard mode in the data file\n");
+			return 0;
+		}
+		xmlFree(buffer);
+	}
+	if (calibrate->nshards <= 1) calibrate->shard_mode = SHARD_MODE_INTERLEAVED;
+
+	// Reading the ABC-SMC data
+	calibrate->population = NULL;
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_ABC_SMC)
+	{
+		if (calibrate->nsimulations < 2)
+		{
+			printf("Bad ABC-SMC particles number in the data file\n");
+			return 0;
+		}
+		if (xmlHasProp(node, XML_QUANTILE))
+		{
+			buffer = xmlGetProp(node, XML_QUANTILE);
+			calibrate->quantile = atof((char*)buffer);
+			xmlFree(buffer);
+			if (calibrate->quantile <= 0. || calibrate->quantile >= 1.)
+			{
+				printf("Bad quantile in the data file\n");
+				return 0;
+			}
+		}
+		else calibrate->quantile = DEFAULT_QUANTILE;
+		if (xmlHasProp(node, XML_POPULATION))
+			calibrate->population = (char*)xmlGetProp(node, XML_POPULATION);
+		else calibrate->population = (char*)xmlStrdup(DEFAULT_POPULATION);
+	}
+
+	// Reading the Sobol indices data
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_SOBOL)
+	{
+		if (xmlHasProp(node, XML_BOOTSTRAP))
+		{
+			buffer = xmlGetProp(node, XML_BOOTSTRAP);
+			calibrate->nbootstraps = strtoul((char*)buffer, NULL, 0);
+			xmlFree(buffer);
+		}
+		else calibrate->nbootstraps = DEFAULT_BOOTSTRAP;
+	}
+
+	// Reading the MCMC data
+	calibrate->chain = NULL;
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_MCMC)
+	{
+		if (calibrate->nsimulations < 4 || calibrate->nsimulations % 2)
+		{
+			printf("Bad MCMC walkers number in the data file\n");
+			return 0;
+		}
+		if (xmlHasProp(node, XML_NOISE))
+		{
+			buffer = xmlGetProp(node, XML_NOISE);
+			calibrate->noise = atof((char*)buffer);
+			xmlFree(buffer);
+			if (calibrate->noise <= 0.)
+			{
+				printf("Bad noise scale in the data file\n");
+				return 0;
+			}
+		}
+		else calibrate->noise = DEFAULT_NOISE;
+		if (xmlHasProp(node, XML_STRETCH))
+		{
+			buffer = xmlGetProp(node, XML_STRETCH);
+			calibrate->stretch = atof((char*)buffer);
+			xmlFree(buffer);
+			if (calibrate->stretch <= 1.)
+			{
+				printf("Bad stretch scale in the data file\n");
+				return 0;
+			}
+		}
+		else calibrate->stretch = DEFAULT_STRETCH;
+		if (xmlHasProp(node, XML_CHAIN))
+			calibrate->chain = (char*)xmlGetProp(node, XML_CHAIN);
+		else calibrate->chain = (char*)xmlStrdup(DEFAULT_CHAIN);
+	}
+
+	// Reading the iterations number
+	if (xmlHasProp(node, XML_ITERATIONS))
+	{
+		buffer = xmlGetProp(node, XML_ITERATIONS);
+		calibrate->niterations = strtoul((char*)buffer, NULL, 0);
+		xmlFree(buffer);
+		if (!calibrate->niterations)
+		{
+			printf("Null iterations number in the data file\n");
+			return 0;
+		}
+	}
+	else calibrate->niterations = 1;
 
-	// Parsing the XML data file
-	doc = xmlParseFile(filename);
-	if (!doc)
+	// Reading the best simulations number
+	if (xmlHasProp(node, XML_BESTS))
 	{
-		printf("Unable to parse the data file %s\n", filename);
-		return 0;
+		buffer = xmlGetProp(node, XML_BESTS);
+		calibrate->nbests = strtoul((char*)buffer, NULL, 0);
+		xmlFree(buffer);
+		if (!calibrate->nbests)
+		{
+			printf("Null bests number in the data file\n");
+			return 0;
+		}
 	}
-
-	// Obtaining the root XML node
-	node = xmlDocGetRootElement(doc);
-	if (!node)
+	else calibrate->nbests = 1;
+	if (calibrate->stop_probability > 0. && calibrate->nbests < STOP_TAIL)
 	{
-		printf("No XML nodes in the data file\n");
+		printf("The stopping rule needs at least %u bests\n", STOP_TAIL);
 		return 0;
 	}
-	if (xmlStrcmp(node->name, XML_CALIBRATE))
+	calibrate->simulation_best
+		= (unsigned int*)malloc(calibrate->nbests * sizeof(unsigned int));
+	calibrate->error_best = (double*)malloc(calibrate->nbests * sizeof(double));
+	calibrate->heap
+		= (unsigned int*)malloc(calibrate->nbests * sizeof(unsigned int));
+	calibrate->nsaveds = 0;
+	calibrate->sorted = 1;
+
+	// Reading the mode to simulate all the experiments in a single run
+	if (xmlHasProp(node, XML_MULTI_EXPERIMENT))
 	{
-		printf("Bad name of the XML root node in the data file\n");
-		return 0;
+		buffer = xmlGetProp(node, XML_MULTI_EXPERIMENT);
+		if (!xmlStrcmp(buffer, XML_MANIFEST))
+			calibrate->multi_experiment = MULTI_EXPERIMENT_MANIFEST;
+		else if (!xmlStrcmp(buffer, XML_ARGUMENTS))
+			calibrate->multi_experiment = MULTI_EXPERIMENT_ARGUMENTS;
+		else
+		{
+			printf("Unknown multi_experiment mode in the data file\n");
+			return 0;
+		}
+		xmlFree(buffer);
 	}
+	else calibrate->multi_experiment = MULTI_EXPERIMENT_NONE;
 
-	// Obtaining the simulator file
-	if (xmlHasProp(node, XML_SIMULATOR))
+	// Reading the failures data
+	if (xmlHasProp(node, XML_RETRIES))
 	{
-		calibrate->simulator = (char*)xmlGetProp(node, XML_SIMULATOR);
+		buffer = xmlGetProp(node, XML_RETRIES);
+		calibrate->retries = strtoul((char*)buffer, NULL, 0);
+		xmlFree(buffer);
 	}
-	else
+	else calibrate->retries = DEFAULT_RETRIES;
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_MCMC
+		|| calibrate->algorithm == CALIBRATE_ALGORITHM_ABC_SMC
+		|| calibrate->algorithm == CALIBRATE_ALGORITHM_SOBOL)
 	{
-		printf("No simulator in the data file\n");
-		return 0;
+		// The failed simulations are excluded from the likelihoods and the
+		// Sobol indices by an infinite objective function value
+		if (xmlHasProp(node, XML_PENALTY))
+		{
+			printf("Penalty with mcmc, abc-smc or sobol-indices algorithms\n");
+			return 0;
+		}
+		calibrate->penalty = INFINITY;
+	}
+	else if (xmlHasProp(node, XML_PENALTY))
+	{
+		buffer = xmlGetProp(node, XML_PENALTY);
+		calibrate->penalty = atof((char*)buffer);
+		xmlFree(buffer);
 	}
+	else calibrate->penalty = DEFAULT_PENALTY;
+	for (i = 0; i < FAILURES; ++i) calibrate->nfailures[i] = 0;
+	calibrate->nretried = calibrate->nexhausted = 0;
 
-	// Obtaining the evaluator file
-	if (xmlHasProp(node, XML_EVALUATOR))
+	// Reading the failure classifier data
+	calibrate->failure_threshold = 1.;
+	calibrate->failure_explore = DEFAULT_FAILURE_EXPLORE;
+	calibrate->nobservations = calibrate->nobserved = calibrate->nfailed
+		= calibrate->nscreened = 0;
+	calibrate->observation = NULL;
+	calibrate->failed = NULL;
+	if (xmlHasProp(node, XML_FAILURE_THRESHOLD))
 	{
-		calibrate->evaluator = (char*)xmlGetProp(node, XML_EVALUATOR);
+		if (calibrate->algorithm == CALIBRATE_ALGORITHM_ABC_SMC
+			|| calibrate->algorithm == CALIBRATE_ALGORITHM_SOBOL)
+		{
+			printf("Failure classifier with abc-smc or sobol-indices "
+				"algorithms\n");
+			return 0;
+		}
+		buffer = xmlGetProp(node, XML_FAILURE_THRESHOLD);
+		calibrate->failure_threshold = atof((char*)buffer);
+		xmlFree(buffer);
+		if (calibrate->failure_threshold < 0.)
+		{
+			printf("Bad failure threshold\n");
+			return 0;
+		}
+		if (xmlHasProp(node, XML_FAILURE_EXPLORE))
+		{
+			buffer = xmlGetProp(node, XML_FAILURE_EXPLORE);
+			calibrate->failure_explore = atof((char*)buffer);
+			xmlFree(buffer);
+			if (calibrate->failure_explore < 0.
+				|| calibrate->failure_explore > 1.)
+			{
+				printf("Bad failure explore probability\n");
+				return 0;
+			}
+		}
 	}
-	else
+	// Reading the control socket data
+	calibrate->control = calibrate->control_log = NULL;
+	calibrate->taken = NULL;
+	calibrate->nbatches = calibrate->npriority = calibrate->halt = 0;
+	if (xmlHasProp(node, XML_CONTROL))
 	{
-		printf("No error in the data file\n");
-		return 0;
+		if (calibrate->algorithm == CALIBRATE_ALGORITHM_ABC_SMC
+			|| calibrate->algorithm == CALIBRATE_ALGORITHM_SOBOL)
+		{
+			printf("Control socket with abc-smc or sobol-indices algorithms\n");
+			return 0;
+		}
+		calibrate->control = (char*)xmlGetProp(node, XML_CONTROL);
+		if (xmlHasProp(node, XML_CONTROL_LOG))
+			calibrate->control_log = (char*)xmlGetProp(node, XML_CONTROL_LOG);
+		else calibrate->control_log
+			= (char*)xmlStrdup(DEFAULT_CONTROL_LOG);
 	}
 
-	// Reading the algorithm
-	if (xmlHasProp(node, XML_ALGORITHM))
+	calibrate->rng_failure = gsl_rng_alloc(gsl_rng_taus2);
+#ifdef HAVE_MPI
+	gsl_rng_set(calibrate->rng_failure, RANDOM_SEED + 2 + calibrate->mpi_rank);
+#else
+	gsl_rng_set(calibrate->rng_failure, RANDOM_SEED + 2);
+#endif
+
+	// Reading the store of the experiment objective function values
+	calibrate->store = NULL;
+	calibrate->budget = 0;
+	if (xmlHasProp(node, XML_STORE))
 	{
-		buffer = xmlGetProp(node, XML_ALGORITHM);
-		if (!xmlStrcmp(buffer, XML_SWEEP))
+		if (calibrate->multi_experiment)
 		{
-			calibrate->algorithm = CALIBRATE_ALGORITHM_SWEEP;
+			printf("Store with multi_experiment mode\n");
+			return 0;
 		}
-		else
+		calibrate->store = (char*)xmlGetProp(node, XML_STORE);
+		if (xmlHasProp(node, XML_BUDGET))
 		{
-			calibrate->algorithm = CALIBRATE_ALGORITHM_GENETIC;
+			buffer = xmlGetProp(node, XML_BUDGET);
+			calibrate->budget = strtoul((char*)buffer, NULL, 0);
+			xmlFree(buffer);
 		}
-		xmlFree(buffer);
 	}
-	else
-	{
-		calibrate->algorithm = CALIBRATE_ALGORITHM_MONTE_CARLO;
 
-		// Obtaining the simulations number
-		if (xmlHasProp(node, XML_SIMULATIONS))
+	// Reading the steady state monitor data
+	calibrate->nsteady = calibrate->nsteady_stops = 0;
+	calibrate->steady_column = NULL;
+	calibrate->steady_saved = 0.;
+	if (xmlHasProp(node, XML_STEADY_COLUMNS))
+	{
+		if (calibrate->multi_experiment)
 		{
-			buffer = xmlGetProp(node, XML_SIMULATIONS);
-			calibrate->nsimulations = strtoul((char*)buffer, NULL, 0);
+			printf("Steady state monitor with multi_experiment mode\n");
+			return 0;
+		}
+		buffer = xmlGetProp(node, XML_STEADY_COLUMNS);
+		for (c = (char*)buffer;; c = c2)
+		{
+			i = strtoul(c, &c2, 0);
+			if (c2 == c) break;
+			if (!i)
+			{
+				printf("Bad steady state column\n");
+				return 0;
+			}
+			calibrate->steady_column = realloc(calibrate->steady_column,
+				(1 + calibrate->nsteady) * sizeof(unsigned int));
+			calibrate->steady_column[calibrate->nsteady++] = i - 1;
+		}
+		xmlFree(buffer);
+		if (!calibrate->nsteady)
+		{
+			printf("No steady state columns in the data file\n");
+			return 0;
+		}
+		if (xmlHasProp(node, XML_STEADY_WINDOW))
+		{
+			buffer = xmlGetProp(node, XML_STEADY_WINDOW);
+			calibrate->steady_window = strtoul((char*)buffer, NULL, 0);
+			xmlFree(buffer);
+			if (calibrate->steady_window < 2)
+			{
+				printf("Bad steady state window in the data file\n");
+				return 0;
+			}
+		}
+		else calibrate->steady_window = DEFAULT_STEADY_WINDOW;
+		if (xmlHasProp(node, XML_STEADY_TOLERANCE))
+		{
+			buffer = xmlGetProp(node, XML_STEADY_TOLERANCE);
+			calibrate->steady_tolerance = atof((char*)buffer);
+			xmlFree(buffer);
+		}
+		else calibrate->steady_tolerance = DEFAULT_STEADY_TOLERANCE;
+		if (xmlHasProp(node, XML_STEADY_ACTION))
+		{
+			buffer = xmlGetProp(node, XML_STEADY_ACTION);
+			if (!xmlStrcmp(buffer, XML_SIGNAL))
+				calibrate->steady_action = STEADY_ACTION_SIGNAL;
+			else if (!xmlStrcmp(buffer, XML_EXTRAPOLATE))
+				calibrate->steady_action = STEADY_ACTION_EXTRAPOLATE;
+			else
+			{
+				printf("Unknown steady state action in the data file\n");
+				return 0;
+			}
+			xmlFree(buffer);
+		}
+		else calibrate->steady_action = STEADY_ACTION_SIGNAL;
+		if (xmlHasProp(node, XML_STEADY_END))
+		{
+			buffer = xmlGetProp(node, XML_STEADY_END);
+			calibrate->steady_end = atof((char*)buffer);
 			xmlFree(buffer);
 		}
 		else
 		{
-			printf("No simulations number in the data file\n");
+			printf("No steady state final time in the data file\n");
 			return 0;
 		}
 	}
 
-	// Reading the iterations number
-	if (xmlHasProp(node, XML_ITERATIONS))
+	// Reading the MPI simulator groups data
+	calibrate->mpi_group = 0;
+	if (xmlHasProp(node, XML_MPI_GROUP))
 	{
-		buffer = xmlGetProp(node, XML_ITERATIONS);
-		calibrate->niterations = strtoul((char*)buffer, NULL, 0);
+#ifdef HAVE_MPI
+		buffer = xmlGetProp(node, XML_MPI_GROUP);
+		i = strtoul((char*)buffer, NULL, 0);
 		xmlFree(buffer);
-		if (!calibrate->niterations)
+		if (!i || calibrate->mpi_tasks <= (int)i
+			|| (calibrate->mpi_tasks - 1) % i)
 		{
-			printf("Null iterations number in the data file\n");
+			printf("The MPI tasks have to be 1 plus a multiple of the MPI "
+				"group size\n");
+			return 0;
+		}
+		if (calibrate->nsteady)
+		{
+			printf("Steady state monitor with MPI groups\n");
+			return 0;
+		}
+		j = (calibrate->mpi_tasks - 1) / i;
+		if (j > 1 && calibrate->mpi_thread < MPI_THREAD_MULTIPLE)
+		{
+			printf("MPI groups on threads without MPI thread support\n");
 			return 0;
 		}
-	}
-	else calibrate->niterations = 1;
 
-	// Reading the best simulations number
-	if (xmlHasProp(node, XML_BESTS))
-	{
-		buffer = xmlGetProp(node, XML_BESTS);
-		calibrate->nbests = strtoul((char*)buffer, NULL, 0);
-		xmlFree(buffer);
-		if (!calibrate->nbests)
+		// Loading the simulator function on all tasks
+		calibrate->mpi_module
+			= g_module_open(calibrate->simulator, G_MODULE_BIND_LAZY);
+		k = calibrate->mpi_module
+			&& g_module_symbol(calibrate->mpi_module, "simulator_run",
+				(gpointer*)&calibrate->mpi_simulator);
+		if (!k)
+			printf("Unable to load the simulator_run function of %s\n",
+				calibrate->simulator);
+		MPI_Allreduce(MPI_IN_PLACE, &k, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+		if (!k)
 		{
-			printf("Null bests number in the data file\n");
+			if (calibrate->mpi_module) g_module_close(calibrate->mpi_module);
 			return 0;
 		}
-	}
-	else calibrate->nbests = 1;
-	calibrate->simulation_best
-		= (unsigned int*)alloca(calibrate->nbests * sizeof(unsigned int));
-	calibrate->error_best = (double*)alloca(calibrate->nbests * sizeof(double));
-#if HAVE_MPI
-	simulation_best
-		= (unsigned int*)alloca(calibrate->nbests * sizeof(unsigned int));
-	error_best = (double*)alloca(calibrate->nbests * sizeof(double));
+
+		// Splitting the tasks in the calibrator task, coordinating the groups,
+		// and the simulator groups
+		MPI_Comm_split(MPI_COMM_WORLD,
+			calibrate->mpi_rank ? 1 + (calibrate->mpi_rank - 1) / i : 0,
+			calibrate->mpi_rank, &calibrate->mpi_comm);
+		calibrate->mpi_group = i;
+		calibrate->mpi_ngroups = j;
+		if (calibrate->mpi_rank)
+		{
+			calibrate_group(calibrate);
+			return 1;
+		}
+
+		// A thread per group on the calibrator task
+		calibrate->mpi_tasks = 1;
+		calibrate->nthreads = j;
+		calibrate->mpi_free = (unsigned int*)malloc(j * sizeof(unsigned int));
+		for (i = 0; i < j; ++i) calibrate->mpi_free[i] = i;
+		calibrate->mpi_nfree = j;
+		printf("MPI groups size=%u groups=%u\n", calibrate->mpi_group, j);
+#else
+		printf("MPI groups without MPI\n");
+		return 0;
 #endif
-	calibrate->nsaveds = 0;
+	}
 
 	// Reading the experimental data file names
 	calibrate->nexperiments = 0;
@@ -863,128 +5827,87 @@ printf("calibrate_new: nexperiments=%u\n", calibrate->nexperiments);
 	calibrate->rangemax = NULL;
 	calibrate->format = NULL;
 	calibrate->nsweeps = NULL;
+	calibrate->ngroups = 0;
+	calibrate->group = (unsigned int*)malloc(sizeof(unsigned int));
+	calibrate->group[0] = 0;
 	if (calibrate->algorithm == CALIBRATE_ALGORITHM_SWEEP)
 		calibrate->nsimulations = 1;
 	for (; child; child = child->next)
 	{
-		if (xmlStrcmp(child->name, XML_VARIABLE))
-		{
-			printf("Bad XML node\n");
-			return 0;
-		}
-		if (xmlHasProp(child, XML_NAME))
-		{
-			calibrate->label = realloc(calibrate->label,
-				(1 + calibrate->nvariables) * sizeof(char*));
-			calibrate->label[calibrate->nvariables] =
-				(char*)xmlGetProp(child, XML_NAME);
-		}
-		else
-		{
-			printf("No variable %u name\n", calibrate->nvariables + 1);
-			return 0;
-		}
-		if (xmlHasProp(child, XML_MINIMUM))
-		{
-			calibrate->rangemin = realloc(calibrate->rangemin,
-				(1 + calibrate->nvariables) * sizeof(double));
-			buffer = xmlGetProp(child, XML_MINIMUM);
-			calibrate->rangemin[calibrate->nvariables] = atof((char*)buffer);
-			xmlFree(buffer);
-		}
-		else
-		{
-			printf("No variable %u minimum range\n", calibrate->nvariables + 1);
-			return 0;
-		}
-		if (xmlHasProp(child, XML_MAXIMUM))
-		{
-			calibrate->rangemax = realloc(calibrate->rangemax,
-				(1 + calibrate->nvariables) * sizeof(double));
-			buffer = xmlGetProp(child, XML_MAXIMUM);
-			calibrate->rangemax[calibrate->nvariables] = atof((char*)buffer);
-			xmlFree(buffer);
-		}
-		else
+		if (!xmlStrcmp(child->name, XML_GROUP))
 		{
-			printf("No variable %u maximum range\n", calibrate->nvariables + 1);
-			return 0;
-		}
-		calibrate->format = realloc(calibrate->format,
-			(1 + calibrate->nvariables) * sizeof(char*));
-		if (xmlHasProp(child, XML_FORMAT))
-		{
-			calibrate->format[calibrate->nvariables] =
-				(char*)xmlGetProp(child, XML_FORMAT);
-		}
-		else
-		{
-			calibrate->format[calibrate->nvariables] =
-				(char*)xmlStrdup(DEFAULT_FORMAT);
-		}
-		if (calibrate->algorithm == CALIBRATE_ALGORITHM_SWEEP)
-		{
-			if (xmlHasProp(child, XML_SWEEPS))
-			{
-				calibrate->nsweeps = realloc(calibrate->nsweeps,
-					(1 + calibrate->nvariables) * sizeof(unsigned int));
-				buffer = xmlGetProp(child, XML_SWEEPS);
-				calibrate->nsweeps[calibrate->nvariables] =
-					strtoul((char*)buffer, NULL, 0);
-				xmlFree(buffer);
-			}
-			else
+			for (variable = child->children; variable;
+				variable = variable->next)
+				if (!calibrate_variable(calibrate, variable)) return 0;
+			if (calibrate->nvariables == calibrate->group[calibrate->ngroups])
 			{
-				printf("No variable %u sweeps number\n",
-					calibrate->nvariables + 1);
+				printf("Empty group %u\n", calibrate->ngroups + 1);
 				return 0;
 			}
-			calibrate->nsimulations *=
-				calibrate->nsweeps[calibrate->nvariables];
-#if DEBUG
-printf("calibrate_new: nsweeps=%u nsimulations=%u\n",
-calibrate->nsweeps[calibrate->nvariables], calibrate->nsimulations);
-#endif
 		}
-		++calibrate->nvariables;
+		else if (!calibrate_variable(calibrate, child)) return 0;
+		calibrate->group = realloc(calibrate->group,
+			(2 + calibrate->ngroups) * sizeof(unsigned int));
+		calibrate->group[++calibrate->ngroups] = calibrate->nvariables;
 	}
 	if (!calibrate->nvariables)
 	{
 		printf("No calibration variables\n");
 		return 0;
 	}
+	if (calibrate->store && !calibrate_store_open(calibrate)) return 0;
+	if (calibrate->control && !calibrate_control_open(calibrate)) return 0;
+	if (calibrate->library && !calibrate_sampler_open(calibrate)) return 0;
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_BLOCK_COORDINATE)
+		for (i = 0; i < calibrate->ngroups; ++i)
+			if (!calibrate_block_size(calibrate, i))
+			{
+				printf("No simulations number in the data file\n");
+				return 0;
+			}
 #if DEBUG
 printf("calibrate_new: nvariables=%u\n", calibrate->nvariables);
 #endif
 
 	// Allocating values
-	calibrate->value = (double*)alloca(calibrate->nsimulations *
-		calibrate->nvariables * sizeof(double));
-
-	// Calculating simulations to perform on each task
+	j = calibrate->nsimulations;
+	if (calibrate->algorithm == CALIBRATE_ALGORITHM_MCMC)
+		j += calibrate->nsimulations / 2;
+	else if (calibrate->algorithm == CALIBRATE_ALGORITHM_ABC_SMC)
+	{
+		// A proposal per thread of every task
+		j = calibrate->nthreads;
 #ifdef HAVE_MPI
-	calibrate->nstart = calibrate->mpi_rank * calibrate->nsimulations
-		/ calibrate->mpi_tasks;
-	calibrate->nend = (1 + calibrate->mpi_rank) * calibrate->nsimulations
-		/ calibrate->mpi_tasks;
-#else
-	calibrate->nstart = 0;
-	calibrate->nend = calibrate->nsimulations;
+		j *= calibrate->mpi_tasks;
 #endif
-#if DEBUG
-printf("calibrate_new: nstart=%u nend=%u\n", calibrate->nstart,
-calibrate->nend);
+	}
+	else if (calibrate->algorithm == CALIBRATE_ALGORITHM_BLOCK_COORDINATE)
+	{
+		// Simulations of the largest stage
+		for (i = j = 0; i < calibrate->ngroups; ++i)
+			if (calibrate_block_size(calibrate, i) > j)
+				j = calibrate_block_size(calibrate, i);
+	}
+	else if (calibrate->algorithm == CALIBRATE_ALGORITHM_SOBOL)
+	{
+		// A Saltelli sample per thread of every task
+		j = calibrate->nthreads * (calibrate->nvariables + 2);
+#ifdef HAVE_MPI
+		j *= calibrate->mpi_tasks;
 #endif
+	}
+	if (calibrate->budget > j) j = calibrate->budget;
+	calibrate->value
+		= (double*)malloc(j * calibrate->nvariables * sizeof(double));
+	calibrate->error = (double*)malloc(j * sizeof(double));
+	calibrate->screened = (unsigned int*)calloc(j, sizeof(unsigned int));
+	calibrate->value_best = (double*)malloc(calibrate->nbests
+		* calibrate->nvariables * sizeof(double));
 
-	// Calculating simulations to perform on each thread
-	calibrate->thread =
-		(unsigned int*)alloca((1 + calibrate->nthreads) * sizeof(unsigned int));
-	for (i = 0; i <= calibrate->nthreads; ++i)
-	   calibrate->thread[i] = calibrate->nstart
-		   + i * (calibrate->nend - calibrate->nstart) / calibrate->nthreads;
-
-	// Performing the algorithm
-	switch (calibrate->algorithm)
+	// Performing the algorithm, or simulating the previous candidates on the
+	// not stored experiments
+	if (calibrate->budget) calibrate_budget(calibrate);
+	else switch (calibrate->algorithm)
 	{
 		// Sweep algorithm
 		case CALIBRATE_ALGORITHM_SWEEP:
@@ -996,32 +5919,138 @@ calibrate->nend);
 			calibrate_genetic(calibrate);
 			break;
 
+		// MCMC algorithm
+		case CALIBRATE_ALGORITHM_MCMC:
+			calibrate_mcmc(calibrate);
+			break;
+
+		// ABC-SMC algorithm
+		case CALIBRATE_ALGORITHM_ABC_SMC:
+			calibrate_abc(calibrate);
+			break;
+
+		// Sobol indices sensitivity analysis
+		case CALIBRATE_ALGORITHM_SOBOL:
+			calibrate_sobol(calibrate);
+			break;
+
+		// Portfolio of algorithms
+		case CALIBRATE_ALGORITHM_PORTFOLIO:
+			calibrate_portfolio(calibrate);
+			break;
+
+		// Block-coordinate algorithm
+		case CALIBRATE_ALGORITHM_BLOCK_COORDINATE:
+			calibrate_block_coordinate(calibrate);
+			break;
+
+		// Sampler plugin
+		case CALIBRATE_ALGORITHM_PLUGIN:
+			calibrate_plugin(calibrate);
+			break;
+
 		// Default Monte-Carlo algorithm
 		default:
 			calibrate_MonteCarlo(calibrate);
 	}
 
+	// Stopping the steering and unloading the sampler plugin
+	if (calibrate->control) calibrate_control_close(calibrate);
+	if (calibrate->sampler) calibrate_sampler_close(calibrate);
+
+	// Saving the sorted results
+#ifdef HAVE_MPI
+	if (!calibrate->mpi_rank)
+#endif
+	if (calibrate->results) calibrate_results(calibrate);
+
 #ifdef HAVE_MPI
+	// Adding the failures of all tasks
+	MPI_Reduce(calibrate->nfailures, nfailures, FAILURES, MPI_UNSIGNED,
+		MPI_SUM, 0, calibrate->mpi_comm);
+	memcpy(calibrate->nfailures, nfailures, FAILURES * sizeof(unsigned int));
+	i = calibrate->nretried;
+	MPI_Reduce(&i, &calibrate->nretried, 1, MPI_UNSIGNED, MPI_SUM, 0,
+		calibrate->mpi_comm);
+	i = calibrate->nexhausted;
+	MPI_Reduce(&i, &calibrate->nexhausted, 1, MPI_UNSIGNED, MPI_SUM, 0,
+		calibrate->mpi_comm);
+	i = calibrate->nscreened;
+	MPI_Reduce(&i, &calibrate->nscreened, 1, MPI_UNSIGNED, MPI_SUM, 0,
+		calibrate->mpi_comm);
+	if (calibrate->control)
+	{
+		i = calibrate->ncancelled;
+		MPI_Reduce(&i, &calibrate->ncancelled, 1, MPI_UNSIGNED, MPI_SUM, 0,
+			calibrate->mpi_comm);
+	}
+
+	// Adding the store statistics of all tasks
+	if (calibrate->store)
+	{
+		i = calibrate->nreused;
+		MPI_Reduce(&i, &calibrate->nreused, 1, MPI_UNSIGNED, MPI_SUM, 0,
+			calibrate->mpi_comm);
+		i = calibrate->nstored;
+		MPI_Reduce(&i, &calibrate->nstored, 1, MPI_UNSIGNED, MPI_SUM, 0,
+			calibrate->mpi_comm);
+	}
+
+	// Adding the performed simulations of all tasks
+	if (calibrate->stop_probability > 0.)
+	{
+		i = calibrate->nevaluated;
+		MPI_Reduce(&i, &calibrate->nevaluated, 1, MPI_UNSIGNED, MPI_SUM, 0,
+			calibrate->mpi_comm);
+	}
+
+	// Adding the steady state stops of all tasks
+	if (calibrate->nsteady)
+	{
+		i = calibrate->nsteady_stops;
+		MPI_Reduce(&i, &calibrate->nsteady_stops, 1, MPI_UNSIGNED, MPI_SUM, 0,
+			calibrate->mpi_comm);
+		e = calibrate->steady_saved;
+		MPI_Reduce(&e, &calibrate->steady_saved, 1, MPI_DOUBLE, MPI_SUM, 0,
+			calibrate->mpi_comm);
+	}
+
 	// Communicating tasks results
 	if (calibrate->mpi_rank == 0)
 	{
+		simulation_best
+			= (unsigned int*)malloc(calibrate->nbests * sizeof(unsigned int));
+		error_best = (double*)malloc(calibrate->nbests * sizeof(double));
+		value_best = (double*)malloc(calibrate->nbests * calibrate->nvariables
+			* sizeof(double));
 		for (i = 1; i < calibrate->mpi_tasks; ++i)
 		{
-			MPI_Recv(&nsaveds, 1, MPI_INT, i, 1, MPI_COMM_WORLD, &mpi_stat);
-			MPI_Recv(simulation_best, calibrate->nsaveds, MPI_INT, i, 1,
-				MPI_COMM_WORLD, &mpi_stat);
-			MPI_Recv(error_best, calibrate->nsaveds, MPI_DOUBLE, i, 1,
-				MPI_COMM_WORLD, &mpi_stat);
-			calibrate_merge(calibrate, nsaveds, simulation_best, error_best);
+			MPI_Recv(&nsaveds, 1, MPI_UNSIGNED, i, 1, calibrate->mpi_comm,
+				&mpi_stat);
+			MPI_Recv(simulation_best, nsaveds, MPI_UNSIGNED, i, 1,
+				calibrate->mpi_comm, &mpi_stat);
+			MPI_Recv(error_best, nsaveds, MPI_DOUBLE, i, 1, calibrate->mpi_comm,
+				&mpi_stat);
+			MPI_Recv(value_best, nsaveds * calibrate->nvariables, MPI_DOUBLE, i,
+				1, calibrate->mpi_comm, &mpi_stat);
+			calibrate_merge(calibrate, nsaveds, simulation_best, error_best,
+				value_best);
 		}
+		free(value_best);
+		free(error_best);
+		free(simulation_best);
 	}
 	else
 	{
-		MPI_Send(&nsaveds, 1, MPI_INT, 0, 1, MPI_COMM_WORLD);
-		MPI_Send(calibrate->simulation_best, calibrate->nsaveds, MPI_INT, 0, 1,
-			MPI_COMM_WORLD);
+		MPI_Send(&calibrate->nsaveds, 1, MPI_UNSIGNED, 0, 1,
+			calibrate->mpi_comm);
+		MPI_Send(calibrate->simulation_best, calibrate->nsaveds, MPI_UNSIGNED,
+			0, 1, calibrate->mpi_comm);
 		MPI_Send(calibrate->error_best, calibrate->nsaveds, MPI_DOUBLE, 0, 1,
-			MPI_COMM_WORLD);
+			calibrate->mpi_comm);
+		MPI_Send(calibrate->value_best,
+			calibrate->nsaveds * calibrate->nvariables, MPI_DOUBLE, 0, 1,
+			calibrate->mpi_comm);
 	}
 #endif
 
@@ -1033,14 +6062,44 @@ calibrate->nend);
 	if (!calibrate->mpi_rank)
 	{
 #endif
-	printf("THE BEST IS\n");
-	printf("error=%le\n", calibrate->error_best[0]);
-	for (i = 0; i < calibrate->nvariables; ++i)
+	calibrate_best_sort(calibrate);
+	if (calibrate->nsaveds)
 	{
-		snprintf(buffer2, 512, "parameter%%u=%s\n", calibrate->format[i]);
-		printf(buffer2, i, calibrate->value[calibrate->simulation_best[0]
-			* calibrate->nvariables + i]);
+		printf("THE BEST IS\n");
+		printf("error=%le\n", calibrate->error_best[0]);
+		for (i = 0; i < calibrate->nvariables; ++i)
+		{
+			snprintf(buffer2, 512, "parameter%%u=%s\n", calibrate->format[i]);
+			printf(buffer2, i, calibrate->value_best[i]);
+		}
 	}
+	if (calibrate->stop_probability > 0.)
+		printf("Monte-Carlo stopping rule: %u of %u simulations\n",
+			calibrate->nevaluated, calibrate->nsimulations);
+	for (i = j = 0; i < FAILURES; ++i) j += calibrate->nfailures[i];
+	if (j)
+		printf("failed experiments: transient=%u signal=%u status=%u "
+			"no output=%u bad result=%u\nretried simulations=%u "
+			"exhausted retries=%u\n",
+			calibrate->nfailures[FAILURE_TRANSIENT],
+			calibrate->nfailures[FAILURE_SIGNAL],
+			calibrate->nfailures[FAILURE_STATUS],
+			calibrate->nfailures[FAILURE_OUTPUT],
+			calibrate->nfailures[FAILURE_RESULT], calibrate->nretried,
+			calibrate->nexhausted);
+	if (calibrate->failure_threshold < 1.)
+		printf("failure classifier skipped simulations=%u\n",
+			calibrate->nscreened);
+	if (calibrate->control)
+		printf("steering batches=%u cancelled simulations=%u%s\n",
+			calibrate->nbatches, calibrate->ncancelled,
+			calibrate->halt ? " stopped" : "");
+	if (calibrate->store)
+		printf("store reused experiments=%u stored experiments=%u\n",
+			calibrate->nreused, calibrate->nstored);
+	if (calibrate->nsteady)
+		printf("steady state stops=%u saved simulated time=%le\n",
+			calibrate->nsteady_stops, calibrate->steady_saved);
 #if HAVE_MPI
 	}
 #endif
@@ -1073,6 +6132,35 @@ calibrate->nend);
 	free(calibrate->rangemax);
 	free(calibrate->format);
 	free(calibrate->nsweeps);
+	free(calibrate->group);
+	free(calibrate->steady_column);
+	free(calibrate->observation);
+	free(calibrate->failed);
+	free(calibrate->heap);
+	free(calibrate->screened);
+	free(calibrate->error);
+	free(calibrate->value);
+	free(calibrate->value_best);
+	free(calibrate->error_best);
+	free(calibrate->simulation_best);
+	xmlFree(calibrate->control);
+	xmlFree(calibrate->control_log);
+	xmlFree(calibrate->library);
+	xmlFree(calibrate->plugin_parameters);
+	xmlFree(calibrate->plugin_state);
+	gsl_rng_free(calibrate->rng_failure);
+	xmlFree(calibrate->chain);
+	xmlFree(calibrate->population);
+	xmlFree(calibrate->results);
+	if (calibrate->store)
+	{
+		fclose(calibrate->file_store);
+		g_hash_table_destroy(calibrate->stored);
+		for (i = 0; i < calibrate->nexperiments; ++i)
+			g_free(calibrate->hash[i]);
+		free(calibrate->hash);
+		xmlFree(calibrate->store);
+	}
 
 #if DEBUG
 printf("calibrate_new: end\n");
@@ -1108,20 +6196,57 @@ int cores_number()
  */
 int main(int argn, char **argc)
 {
+	int i;
 	Calibrate calibrate[1];
 
 #ifdef HAVE_MPI
-	// Starting MPI
-	MPI_Init(&argn, &argc);
+	// Starting MPI, with thread support to run MPI groups on threads
+	MPI_Init_thread(&argn, &argc, MPI_THREAD_MULTIPLE, &calibrate->mpi_thread);
 	MPI_Comm_size(MPI_COMM_WORLD, &calibrate->mpi_tasks);
 	MPI_Comm_rank(MPI_COMM_WORLD, &calibrate->mpi_rank);
 	printf("rank=%d tasks=%d\n", calibrate->mpi_rank, calibrate->mpi_tasks);
+	calibrate->mpi_comm = MPI_COMM_WORLD;
+	calibrate->mpi_group = 0;
+#endif
+
+	// Merging results files
+	if (argn >= 4 && !strcmp(argc[1], "--merge"))
+	{
+		i = 1;
+#ifdef HAVE_MPI
+		if (!calibrate->mpi_rank)
+#endif
+		i = results_merge(argc[2], argn - 3, argc + 3);
+#ifdef HAVE_MPI
+		// Closing MPI
+		MPI_Finalize();
 #endif
+		return !i;
+	}
+
+	// Reading the command line options
+	calibrate->nthreads = cores_number();
+	calibrate->nshards = 1;
+	calibrate->shard = 0;
+	for (i = 1; i < argn - 1; i += 2)
+	{
+		if (!strcmp(argc[i], "-nthreads"))
+			calibrate->nthreads = atoi(argc[i + 1]);
+		else if (!strcmp(argc[i], "--shard")
+			&& sscanf(argc[i + 1], "%u/%u", &calibrate->shard,
+				&calibrate->nshards) == 2
+			&& calibrate->shard < calibrate->nshards)
+			continue;
+		else break;
+	}
 
 	// Checking sintaxis
-	if (!(argn == 2 || (argn == 4 && !strcmp(argc[1], "-nthreads"))))
+	if (i != argn - 1 || !calibrate->nthreads)
 	{
-		printf("The sintaxis is:\ncalibrator [-nthreads x] data_file\n");
+		printf("The sintaxis is:\n"
+			"calibrator [-nthreads x] [--shard i/K] data_file\n"
+			"calibrator --merge output_file results_file_1 "
+			"[results_file_2 ...]\n");
 #ifdef HAVE_MPI
 		// Closing MPI
 		MPI_Finalize();
@@ -1130,9 +6255,9 @@ int main(int argn, char **argc)
 	}
 
 	// Starting GThreads
-	if (argn == 2) calibrate->nthreads = cores_number();
-	else calibrate->nthreads = atoi(argc[2]);
 	printf("nthreads=%u\n", calibrate->nthreads);
+	if (calibrate->nshards > 1)
+		printf("shard=%u/%u\n", calibrate->shard, calibrate->nshards);
 
 	// Starting pseudo-random numbers generator
 	rng = gsl_rng_alloc(gsl_rng_taus2);
@@ -1143,6 +6268,10 @@ int main(int argn, char **argc)
 
 	// Making calibration
 	calibrate_new(calibrate, argc[argn - 1]);
+#ifdef HAVE_MPI
+	// Stopping the MPI simulator groups
+	if (calibrate->mpi_group) calibrate_group_close(calibrate);
+#endif
 
 	// Freeing memory
 	gsl_rng_free(rng);
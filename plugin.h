@@ -0,0 +1,170 @@
+/*
+Calibrator: a software to make calibrations of empirical parameters.
+
+AUTHORS: Javier Burguete and Borja Latorre.
+
+Copyright 2012-2013, AUTHORS.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+		this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY AUTHORS ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+/**
+ * \file plugin.h
+ * \brief Header file of the sampler plugins interface. A sampler plugin is a
+ *   shared library exporting the functions declared here. The calibrator asks
+ *   the sampler for simulations, performs them in parallel, and reports the
+ *   objective function values back to the sampler. On a single task without
+ *   control socket, the sampler is driven asynchronously: a simulation is
+ *   proposed when a thread is free and observed as soon as it finishes, so
+ *   the proposals and the observations are interleaved. Otherwise, the
+ *   sampler is driven by batches, observed when the whole batch is finished.
+ *   The calls to the sampler are never simultaneous.
+ * \authors Javier Burguete and Borja Latorre.
+ * \copyright Copyright 2013, all rights reserved.
+ */
+#ifndef PLUGIN__H
+#define PLUGIN__H 1
+
+#include <stdio.h>
+
+/**
+ * \def SAMPLER_ABI
+ * \brief Version of the sampler plugins interface.
+ */
+#define SAMPLER_ABI 2
+
+/**
+ * \struct SamplerInfo
+ * \brief Struct to pass the calibration data to a sampler plugin.
+ */
+typedef struct
+{
+/**
+ * \var nvariables
+ * \brief Number of variables.
+ * \var nsimulations
+ * \brief Maximum number of simulations of a batch.
+ * \var niterations
+ * \brief Maximum number of batches (nsimulations * niterations is the maximum
+ *   number of simulations on the asynchronous mode).
+ * \var seed
+ * \brief Pseudo-random numbers seed (the same on all MPI tasks).
+ * \var label
+ * \brief Array of variable labels.
+ * \var rangemin
+ * \brief Array of minimum variable values.
+ * \var rangemax
+ * \brief Array of maximum variable values.
+ * \var parameters
+ * \brief Parameters string of the sampler (empty if not defined).
+ */
+	unsigned int nvariables, nsimulations, niterations;
+	unsigned long int seed;
+	const char **label;
+	const double *rangemin, *rangemax;
+	const char *parameters;
+} SamplerInfo;
+
+/**
+ * \fn unsigned int sampler_abi(void)
+ * \brief Function to get the version of the interface of the plugin.
+ * \return SAMPLER_ABI.
+ */
+unsigned int sampler_abi(void);
+
+/**
+ * \fn void* sampler_new(const SamplerInfo *info)
+ * \brief Function to create a sampler.
+ * \param info
+ * \brief Calibration data. The arrays are valid until sampler_free.
+ * \return Sampler data pointer, NULL on error.
+ */
+void* sampler_new(const SamplerInfo *info);
+
+/**
+ * \fn unsigned int sampler_propose(void *sampler, double *value, \
+ *   unsigned int nsimulations)
+ * \brief Function to propose a batch of simulations, of one simulation on the
+ *   asynchronous mode.
+ * \param sampler
+ * \brief Sampler data pointer.
+ * \param value
+ * \brief Array of variable values to fill (nvariables values per simulation).
+ * \param nsimulations
+ * \brief Maximum number of simulations of the batch.
+ * \return Number of proposed simulations, 0 to finish the calibration. On the
+ *   asynchronous mode, 0 with proposed simulations not observed yet waits for
+ *   the next observation to ask again.
+ */
+unsigned int sampler_propose(void *sampler, double *value,
+	unsigned int nsimulations);
+
+/**
+ * \fn void sampler_observe(void *sampler, const double *value, \
+ *   const double *error, unsigned int nsimulations)
+ * \brief Function to report the objective function values of a batch, of a
+ *   simulation on the asynchronous mode (not in proposal order).
+ * \param sampler
+ * \brief Sampler data pointer.
+ * \param value
+ * \brief Array of variable values of the batch.
+ * \param error
+ * \brief Array of objective function values of the batch (NAN on not
+ *   performed simulations).
+ * \param nsimulations
+ * \brief Number of simulations of the batch.
+ */
+void sampler_observe(void *sampler, const double *value, const double *error,
+	unsigned int nsimulations);
+
+/**
+ * \fn int sampler_save(void *sampler, FILE *file)
+ * \brief Function to save the sampler state. On the asynchronous mode, the
+ *   proposed simulations not observed yet are not performed after a restore.
+ * \param sampler
+ * \brief Sampler data pointer.
+ * \param file
+ * \brief State file.
+ * \return 1 on success, 0 on error.
+ */
+int sampler_save(void *sampler, FILE *file);
+
+/**
+ * \fn int sampler_restore(void *sampler, FILE *file)
+ * \brief Function to restore a saved sampler state.
+ * \param sampler
+ * \brief Sampler data pointer.
+ * \param file
+ * \brief State file.
+ * \return 1 on success, 0 on error.
+ */
+int sampler_restore(void *sampler, FILE *file);
+
+/**
+ * \fn void sampler_free(void *sampler)
+ * \brief Function to free the memory of a sampler.
+ * \param sampler
+ * \brief Sampler data pointer.
+ */
+void sampler_free(void *sampler);
+
+#endif